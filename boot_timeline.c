@@ -0,0 +1,35 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "int.h"
+#include "mac_time.h"
+
+#include "boot_timeline.h"
+
+// Time before clock setup isn't covered, as the MAC timer isn't running yet.
+// Static xdata is zeroed at reset, so no setup is needed.
+
+static __xdata struct boot_timeline timeline;
+
+void
+boot_stage(u8 stage)
+{
+	u16 bit = 1 << stage;
+
+	__critical {
+		if (!(timeline.reached & bit)) {
+			timeline.time[stage] = mac_time_now();
+			timeline.reached |= bit;
+		}
+	}
+}
+
+const __xdata struct boot_timeline *
+boot_timeline(void)
+{
+	timeline.version = BOOT_TIMELINE_VERSION;
+	timeline.count = BOOT_STAGE_COUNT;
+
+	return &timeline;
+}
@@ -0,0 +1,39 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "int.h"
+
+// MAC time stamps of boot stages, from clock setup to first frame delivered
+
+enum boot_stage {
+	BOOT_CLOCK          = 0,  // MAC timer running. Time reference
+	BOOT_RADIO_SETUP    = 1,
+	BOOT_FLASH_CONFIG   = 2,  // Flash config applied, if any
+	BOOT_USB_PLL        = 3,  // USB PLL locked
+	BOOT_USB_INIT       = 4,  // Descriptors rendered
+	BOOT_RUNNING        = 5,  // About to enable interrupts
+	BOOT_USB_RESET      = 6,  // First USB reset
+	BOOT_USB_ADDRESS    = 7,
+	BOOT_USB_CONFIGURED = 8,
+	BOOT_FIRST_RX       = 9,  // First frame received by radio
+	BOOT_FIRST_FRAME    = 10, // First frame handed to USB
+	BOOT_STAGE_COUNT,
+};
+
+#define BOOT_TIMELINE_VERSION 1
+
+struct boot_timeline {
+	u8 version;    // BOOT_TIMELINE_VERSION
+	u8 count;      // BOOT_STAGE_COUNT
+	u16 reached;   // Bit n set, if stage n has been reached
+	u32 time[BOOT_STAGE_COUNT]; // MAC time, see mac_time.h
+};
+
+// Only the first time a stage is reached is recorded
+void
+boot_stage(u8 stage);
+
+const __xdata struct boot_timeline *
+boot_timeline(void);
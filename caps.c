@@ -0,0 +1,105 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "config/misc.h"
+#include "indirect.h"
+#include "int.h"
+#include "log.h"
+#include "mac_time.h"
+#include "notify.h"
+#include "poll_responder.h"
+#include "sof_time.h"
+#include "tx.h"
+#include "tx_report.h"
+#include "tx_template.h"
+#include "usb_config.h"
+
+#include "caps.h"
+
+// Host reads this once at start-up, instead of probing requests one by one
+
+static __xdata struct caps caps;
+
+static u8
+build_options(void)
+{
+	u8 build = 0;
+
+#ifdef PROFILE_ISR
+	build |= CAPS_BUILD_PROFILE_ISR;
+#endif
+#ifdef LOG_TOKENIZED
+	build |= CAPS_BUILD_LOG_TOKENIZED;
+#endif
+	if (CONFIG_USB_REMOTE_WAKEUP)
+		build |= CAPS_BUILD_REMOTE_WAKEUP;
+
+	return build;
+}
+
+static u16
+enabled_features(void)
+{
+	u16 enabled = 0;
+
+	if (tx_report_enabled())
+		enabled |= FEATURE_TX_REPORT;
+	if (notify_packed())
+		enabled |= FEATURE_NOTIFY_PACKED;
+	if (sof_time_enabled())
+		enabled |= FEATURE_SOF_TIME;
+	if (poll_responder_enabled())
+		enabled |= FEATURE_POLL_RESPONDER;
+
+	return enabled;
+}
+
+const __xdata struct caps *
+caps_get(void)
+{
+	caps.version = CAPS_VERSION;
+	caps.size = sizeof(caps);
+	caps.protocol = CAPS_PROTOCOL_VERSION;
+	caps.max_request = USB_REQ_VENDOR_GET_BOOT_TIMELINE;
+	caps.features = CAPS_FEATURES;
+	caps.enabled = enabled_features();
+	caps.build = build_options();
+	caps.tx_max_len = TX_MAX_LEN;
+	caps.tx_template_count = CONFIG_TX_TEMPLATE_COUNT;
+	caps.tx_template_len = TX_TEMPLATE_MAX_LEN;
+	caps.tx_patch_len = TX_TEMPLATE_PATCH_MAX_LEN;
+	caps.indirect_queue_len = CONFIG_INDIRECT_QUEUE_LEN;
+	caps.indirect_len = INDIRECT_MAX_LEN;
+	caps.notify_ring_len = CONFIG_NOTIFY_RING_LEN;
+	caps.int_ep_size = INT_EP_MAXPKTSIZE;
+	caps.rx_ep_size = RXPKT_EP_MAXPKTSIZE;
+	caps.sof_time_count = CONFIG_SOF_TIME_COUNT;
+	caps.trace_len = CONFIG_TRACE_LEN;
+	caps.mac_timer_hz = 32000000;
+	caps.mac_timer_period = MAC_TIMER_PERIOD;
+
+	return &caps;
+}
+
+__bit
+caps_set_features(u16 features)
+{
+	LOGDX16(__func__, features);
+
+	if (features & ~CAPS_FEATURES)
+		return 1;
+
+	u16 changed = features ^ enabled_features();
+
+	if (changed & FEATURE_TX_REPORT)
+		tx_report_enable((features & FEATURE_TX_REPORT) != 0);
+	if (changed & FEATURE_NOTIFY_PACKED)
+		notify_set_packed((features & FEATURE_NOTIFY_PACKED) != 0);
+	if (changed & FEATURE_SOF_TIME)
+		sof_time_enable((features & FEATURE_SOF_TIME) != 0);
+	if (changed & FEATURE_POLL_RESPONDER)
+		poll_responder_enable((features & FEATURE_POLL_RESPONDER) != 0);
+
+	return 0;
+}
@@ -0,0 +1,60 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "bsp/bits.h"
+#include "int.h"
+
+#define CAPS_VERSION 1
+
+// Bumped when existing requests change meaning. New requests and fields
+// don't bump it, they're found with max_request and caps size.
+#define CAPS_PROTOCOL_VERSION 1
+
+// Features that can be switched at run time, with Set features
+enum caps_feature {
+	FEATURE_TX_REPORT      = BIT(0), // Same as Set TX report format
+	FEATURE_NOTIFY_PACKED  = BIT(1), // Same as Set status format
+	FEATURE_SOF_TIME       = BIT(2), // Same as SOF time capture
+	FEATURE_POLL_RESPONDER = BIT(3), // Same as Poll auto-responder
+};
+
+#define CAPS_FEATURES (FEATURE_TX_REPORT | FEATURE_NOTIFY_PACKED | FEATURE_SOF_TIME | FEATURE_POLL_RESPONDER)
+
+// Build options
+enum caps_build {
+	CAPS_BUILD_PROFILE_ISR   = BIT(0),
+	CAPS_BUILD_LOG_TOKENIZED = BIT(1),
+	CAPS_BUILD_REMOTE_WAKEUP = BIT(2),
+};
+
+struct caps {
+	u8 version;            // CAPS_VERSION
+	u8 size;               // sizeof(struct caps)
+	u8 protocol;           // CAPS_PROTOCOL_VERSION
+	u8 max_request;        // Highest vendor request number
+	u16 features;          // Supported, enum caps_feature
+	u16 enabled;           // Currently enabled, enum caps_feature
+	u8 build;              // enum caps_build
+	u8 tx_max_len;         // Largest frame for transmit, without FCS
+	u8 tx_template_count;
+	u8 tx_template_len;
+	u8 tx_patch_len;       // Largest list of patches
+	u8 indirect_queue_len;
+	u8 indirect_len;       // Largest indirect frame, without FCS
+	u8 notify_ring_len;    // Bytes
+	u8 int_ep_size;        // Status endpoint max packet size
+	u8 rx_ep_size;         // Receive endpoint max packet size
+	u8 sof_time_count;
+	u8 trace_len;
+	u32 mac_timer_hz;      // MAC timer tick rate
+	u16 mac_timer_period;  // Ticks per MAC timer overflow
+};
+
+const __xdata struct caps *
+caps_get(void);
+
+// Returns non-zero if features has unsupported bits set
+__bit
+caps_set_features(u16 features);
@@ -9,3 +9,28 @@
 // Sleeping (PM1): 0.44 mA
 #define CONFIG_VBUS_MAX_CURRENT_MA 50
 
+// Number of frame templates for template based transmit
+#define CONFIG_TX_TEMPLATE_COUNT 4
+
+// Number of frames that can be held for indirect transmission
+#define CONFIG_INDIRECT_QUEUE_LEN 4
+
+// Size of queue for status endpoint events, in bytes. Must be a power of 2.
+#define CONFIG_NOTIFY_RING_LEN 128
+
+// Advertise USB remote wakeup. When enabled by host, the radio is kept
+// in RX while the bus is suspended, and a received frame wakes up host.
+// NOTE: Exceeds the USB suspend current limit, while armed.
+#define CONFIG_USB_REMOTE_WAKEUP 0
+
+// Number of (USB frame number, MAC time) pairs kept for host time sync
+#define CONFIG_SOF_TIME_COUNT 8
+
+// Number of entries in event trace buffer (8 bytes each)
+#define CONFIG_TRACE_LEN 48
+
+// Bytes of frames held back during fast boot, until host has configured us
+#define CONFIG_RX_EARLY_BUF_LEN 256
+
+// Cycle budgets for PROFILE_ISR=1 are in config/profile_budgets.h, generated
+// from tools/cycle_budgets.txt
@@ -0,0 +1,47 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+// Generated from tools/cycle_budgets.txt by tools/cyclebudget.py header.
+// Don't edit, edit the budgets and run make config/profile_budgets.h.
+
+#pragma once
+
+// Cycles (32 MHz) per run, counted over budget by the ISR profiler.
+// 0: No budget
+
+#define PROFILE_BUDGET_RF      2000  // unmeasured
+#define PROFILE_BUDGET_RFERR   1000  // unmeasured
+#define PROFILE_BUDGET_USB     4000  // unmeasured
+
+// Vendor requests, by bRequest
+#define PROFILE_BUDGET_REQS { \
+	  600,  /* xdata_read, unmeasured */ \
+	    0,  /* xdata_write */ \
+	    0,  /* fifo_read */ \
+	    0,  /* fifo_write */ \
+	 1500,  /* tx, unmeasured */ \
+	    0,  /* set_csma */ \
+	    0,  /* tx_template_set */ \
+	    0,  /* tx_template */ \
+	    0,  /* indirect_queue */ \
+	    0,  /* indirect_purge */ \
+	    0,  /* set_poll_responder */ \
+	    0,  /* get_poll_count */ \
+	    0,  /* tx_params */ \
+	    0,  /* set_tx_report */ \
+	    0,  /* set_notify */ \
+	    0,  /* set_wake_filter */ \
+	    0,  /* get_sof_time */ \
+	    0,  /* set_sof_time */ \
+	    0,  /* get_profile */ \
+	    0,  /* get_trace */ \
+	    0,  /* get_latency */ \
+	    0,  /* get_stats */ \
+	    0,  /* get_mem_usage */ \
+	    0,  /* get_caps */ \
+	    0,  /* set_features */ \
+	    0,  /* config_write */ \
+	    0,  /* config_read */ \
+	    0,  /* get_boot_timeline */ \
+}
@@ -40,7 +40,7 @@ static const struct {
 	    .wTotalLength         = sizeof(configuration_desc),
 	    .bNumInterfaces       = 2,
 	    .bConfigurationValue  = 1,
-	    .bmAttributes         = { .usb1_bus_powered = 1 },
+	    .bmAttributes         = { .usb1_bus_powered = 1, .remote_wakeup = CONFIG_USB_REMOTE_WAKEUP },
 	    .MaxPower             = USB_DESC_MILLIAMPS(CONFIG_VBUS_MAX_CURRENT_MA),
 	 },
 	.wpan = {
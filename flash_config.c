@@ -0,0 +1,212 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "bsp/csp.h"
+#include "bsp/dma.h"
+#include "bsp/flash.h"
+#include "bsp/mem.h"
+#include "bsp/radio.h"
+
+#include "int.h"
+#include "log.h"
+#include "rx.h"
+#include "tx.h"
+
+#include "flash_config.h"
+
+// The config page is right after the firmware, below the top of bank 0.
+// Code size is limited by the Makefile, so the firmware never grows into it,
+// and the bootloader only erases pages it writes, so it survives updates.
+
+#define PAGE_SIZE 2048
+#define WORD_SIZE 4
+
+static const __code __at(CONFIG_PAGE_ADDR) u8 page[FLASH_CONFIG_MAX_LEN];
+
+// Flash is written by DMA channel 1, triggered by the flash controller for
+// each byte. EP0 owns channel 0.
+static struct dma_conf flash_dma;
+
+static __xdata u8 staged[FLASH_CONFIG_MAX_LEN];
+static u8 staged_len;
+static __bit write_pending;
+
+static __bit
+config_invalid(const __xdata u8 * p, u16 len)
+{
+	const __xdata struct flash_config * c = (const __xdata struct flash_config *)p;
+
+	if (len < sizeof(*c) || c->magic != FLASH_CONFIG_MAGIC || c->version != FLASH_CONFIG_VERSION)
+		return 1;
+
+	if (sizeof(*c) + c->len > len)
+		return 1;
+
+	u8 sum = 0;
+	u8 n = sizeof(*c) + c->len;
+	const __xdata u8 * q = p;
+	do {
+		sum += *q++;
+	} while (--n);
+
+	if (sum)
+		return 1;
+
+	// Every register write must be whole, and within range
+	p += sizeof(*c);
+	u8 left = c->len;
+	while (left) {
+		if (left < 3)
+			return 1;
+
+		u16 addr = p[0] | (p[1] << 8);
+		n = p[2];
+		left -= 3;
+
+		if (!n || n > left)
+			return 1;
+
+		if (addr < FLASH_CONFIG_ADDR_MIN || addr >= FLASH_CONFIG_ADDR_END || n > FLASH_CONFIG_ADDR_END - addr)
+			return 1;
+
+		p += 3 + n;
+		left -= n;
+	}
+
+	return 0;
+}
+
+void
+flash_config_apply(void)
+{
+	const __xdata u8 * p = mmap_code_to_xdata(page);
+	const __xdata struct flash_config * c = (const __xdata struct flash_config *)p;
+
+	// Erased flash reads as all ones, so no magic
+	if (config_invalid(p, FLASH_CONFIG_MAX_LEN)) {
+		LOGD("no flash config");
+		return;
+	}
+
+	LOGI(__func__);
+
+	p += sizeof(*c);
+	u8 left = c->len;
+	while (left) {
+		__xdata u8 * dst = (__xdata u8 *)(p[0] | (p[1] << 8));
+		u8 n = p[2];
+		p += 3;
+		left -= 3 + n;
+
+		do {
+			*dst++ = *p++;
+		} while (--n);
+	}
+
+	if (c->flags & FLASH_CONFIG_CSMA)
+		tx_set_csma_params(c->csma);
+
+	// Fast boot: Frames are ACKed and held back, until host has configured us
+	if (c->flags & FLASH_CONFIG_RX_ON)
+		rx_early_start();
+}
+
+u8 __xdata *
+flash_config_write_begin(u16 len)
+{
+	LOGDX16(__func__, len);
+
+	if (write_pending || len > FLASH_CONFIG_MAX_LEN)
+		return NULL;
+
+	staged_len = len;
+
+	return staged;
+}
+
+void
+flash_config_write_done(void)
+{
+	// Nothing at all just erases the config.
+	// It's too late to stall, so host has to read back to see if it stuck.
+	if (staged_len && config_invalid(staged, staged_len)) {
+		LOGW("invalid flash config");
+		return;
+	}
+
+	// Pad to whole flash words, with the value of erased flash
+	while (staged_len & (WORD_SIZE - 1))
+		staged[staged_len++] = 0xff;
+
+	write_pending = 1;
+}
+
+static void
+wait_flash(void)
+{
+	while (FLASH.ctl & FLASH_CTL_BUSY)
+		;
+}
+
+static void
+erase_page(void)
+{
+	// Flash address is in words, and the page number in bits 7:1 of high byte
+	u16 addr = CONFIG_PAGE_ADDR / WORD_SIZE;
+
+	wait_flash();
+	FLASH.addrl = addr;
+	FLASH.addrh = addr >> 8;
+
+	// CPU is halted until erase is done
+	FLASH.ctl = FLASH_CTL_CACHE_MODE_PREFETCH | FLASH_CTL_ERASE;
+	wait_flash();
+}
+
+static void
+write_page(void)
+{
+	u16 addr = CONFIG_PAGE_ADDR / WORD_SIZE;
+
+	dma_set_mode1(flash_dma, TRIG_FLASH, BYTEMODE, ONESHOT, WORD8);
+	dma_set_src(flash_dma, staged);
+	dma_set_dst(flash_dma, &FLASH.wrdata);
+	dma_set_len(flash_dma, staged_len);
+	flash_dma.mode2 = DMA_MODE2(PRIORITY_HIGH, NO_MASK8, INTR_DISABLE, DST_CONST, SRC_CONST)
+	                | (1 << DMA_MODE2_SRCMODE_SHIFT);
+	dma_init_ch1234(mmap_idata_to_xdata(&flash_dma));
+
+	wait_flash();
+	FLASH.addrl = addr;
+	FLASH.addrh = addr >> 8;
+
+	dma_arm(1);
+
+	// Flash controller triggers DMA until all words are written
+	FLASH.ctl = FLASH_CTL_CACHE_MODE_PREFETCH | FLASH_CTL_WRITE;
+	while (dma_is_armed(1))
+		;
+	wait_flash();
+}
+
+void
+flash_config_poll(void)
+{
+	if (!write_pending)
+		return;
+
+	LOGI(__func__);
+
+	erase_page();
+	if (staged_len)
+		write_page();
+
+	write_pending = 0;
+}
+
+const __xdata u8 *
+flash_config_read(void)
+{
+	return mmap_code_to_xdata(page);
+}
@@ -0,0 +1,55 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "bsp/bits.h"
+#include "int.h"
+
+// Radio configuration kept in a flash page of its own, applied at boot.
+// See README.md for the format.
+
+#define FLASH_CONFIG_MAGIC   0x4643 // "CF"
+#define FLASH_CONFIG_VERSION 1
+
+// Largest config image, header included. Multiple of flash word size (4).
+#define FLASH_CONFIG_MAX_LEN 128
+
+// Register writes are limited to radio registers and source match table
+#define FLASH_CONFIG_ADDR_MIN 0x6100
+#define FLASH_CONFIG_ADDR_END 0x6200
+
+enum flash_config_flags {
+	FLASH_CONFIG_RX_ON = BIT(0), // Fast boot: Start receiving at boot
+	FLASH_CONFIG_CSMA  = BIT(1), // Apply csma
+};
+
+struct flash_config {
+	u16 magic;     // FLASH_CONFIG_MAGIC
+	u8 version;    // FLASH_CONFIG_VERSION
+	u8 flags;      // enum flash_config_flags
+	u16 csma;      // Packed like wValue of Set CSMA parameters request
+	u8 len;        // Length of register writes following the header
+	u8 checksum;   // Makes the sum of all bytes, header included, 0
+	// Register writes: { u16 addr; u8 n; u8 data[n]; } ...
+};
+
+// Apply config from flash, if any. Call after radio_setup().
+void
+flash_config_apply(void);
+
+// Config image is received here. NULL if a write is already in progress.
+u8 __xdata *
+flash_config_write_begin(u16 len);
+
+// Invalid images are ignored
+void
+flash_config_write_done(void);
+
+// Erase and write the flash page, if requested. Call from main loop.
+void
+flash_config_poll(void);
+
+// Config as stored in flash, mapped to XDATA
+const __xdata u8 *
+flash_config_read(void);
@@ -0,0 +1,297 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "bsp/bits.h"
+#include "bsp/radio.h"
+
+#include "config/misc.h"
+#include "int.h"
+#include "log.h"
+#include "mac_frame.h"
+#include "mac_time.h"
+#include "src_match.h"
+#include "tx.h"
+#include "tx_report.h"
+
+#include "indirect.h"
+
+// Frames for sleepy devices are held here until they are polled with a
+// data request command.
+//
+// Every slot owns an entry in the radio's source address matching table,
+// so the radio sets frame pending in the ACK to the data request by itself.
+// The frame is loaded into the tx fifo as soon as the data request has been
+// received, and sent as soon as the ACK is done.
+
+// The firmware owns the top entries of the table
+#define SLOT_ENTRY(_slot) (SRC_MATCH_EXT_ENTRIES - CONFIG_INDIRECT_QUEUE_LEN + (_slot))
+
+#define NO_SLOT 0xff
+
+// Max time from data request received, to ACK sent, in MAC timer overflows
+#define ACK_TIMEOUT 2
+
+enum slot_state {
+	SLOT_FREE,
+	SLOT_LOADING,
+	SLOT_QUEUED,
+	SLOT_SENDING,
+};
+
+static __xdata struct {
+	u8 state;
+	u8 handle;
+	u16 expiry;
+	u8 len;
+	u8 frame[INDIRECT_MAX_LEN];
+} slots[CONFIG_INDIRECT_QUEUE_LEN];
+
+static u8 loading_slot = NO_SLOT;
+static u8 armed_slot = NO_SLOT;
+static u8 active_slot = NO_SLOT;
+static u16 persistence;
+static u16 armed_time;
+
+inline u16
+frame_fcf(__xdata u8 * frame)
+{
+	return frame[0] | (frame[1] << 8);
+}
+
+static void
+src_match_set(u8 slot)
+{
+	__xdata u8 * frame = slots[slot].frame;
+	u8 entry = SLOT_ENTRY(slot);
+	u8 bit = entry * 2;
+	u8 mask = BIT(bit & 7);
+	u8 i = bit >> 3;
+
+	__xdata u8 * dst = SRC_MATCH_TABLE + entry * 8;
+	__xdata u8 * src;
+	u8 n;
+
+	if (MAC_FCF_DST_ADDR_MODE(frame_fcf(frame)) == MAC_ADDR_MODE_EXT) {
+		src = &frame[MAC_DST_OFFSET];
+		n = 8;
+	} else {
+		// PAN ID followed by short address, exactly like in the frame
+		src = &frame[MAC_DST_PAN_OFFSET];
+		n = 4;
+	}
+
+	do {
+		*dst++ = *src++;
+	} while (--n);
+
+	if (MAC_FCF_DST_ADDR_MODE(frame_fcf(frame)) == MAC_ADDR_MODE_EXT) {
+		RADIO.srcexten[i] |= mask;
+		RADIO.srcextpenden[i] |= mask;
+	} else {
+		RADIO.srcshorten[i] |= mask;
+		RADIO.srcshortpenden[i] |= mask;
+	}
+}
+
+static void
+src_match_clear(u8 slot)
+{
+	u8 bit = SLOT_ENTRY(slot) * 2;
+	u8 mask = ~BIT(bit & 7);
+	u8 i = bit >> 3;
+
+	RADIO.srcexten[i] &= mask;
+	RADIO.srcextpenden[i] &= mask;
+	RADIO.srcshorten[i] &= mask;
+	RADIO.srcshortpenden[i] &= mask;
+}
+
+static void
+slot_done(u8 slot, u8 status)
+{
+	src_match_clear(slot);
+	slots[slot].state = SLOT_FREE;
+	tx_report_indirect(status, slots[slot].handle);
+
+	LOGDX8("indirect done", slots[slot].handle);
+}
+
+u8 __xdata *
+indirect_enqueue_begin(u8 handle, u16 persistence_time, u16 len)
+{
+	LOGDX8(__func__, handle);
+
+	// A previous request may have been aborted
+	if (loading_slot != NO_SLOT) {
+		slots[loading_slot].state = SLOT_FREE;
+		loading_slot = NO_SLOT;
+	}
+
+	// Must at least have FCF, DSN, and destination PAN ID and address
+	if (len < MAC_DST_OFFSET + 2 || len > INDIRECT_MAX_LEN)
+		return NULL;
+
+	u8 slot = 0;
+	while (slots[slot].state != SLOT_FREE) {
+		if (++slot == CONFIG_INDIRECT_QUEUE_LEN)
+			return NULL;
+	}
+
+	slots[slot].state = SLOT_LOADING;
+	slots[slot].handle = handle;
+	slots[slot].len = len;
+
+	loading_slot = slot;
+	persistence = persistence_time;
+
+	return slots[slot].frame;
+}
+
+void
+indirect_enqueue_done(void)
+{
+	u8 slot = loading_slot;
+	loading_slot = NO_SLOT;
+
+	u16 fcf = frame_fcf(slots[slot].frame);
+	u8 dst_len = mac_addr_len(MAC_FCF_DST_ADDR_MODE(fcf));
+
+	if (!dst_len || slots[slot].len < MAC_DST_OFFSET + dst_len) {
+		slots[slot].state = SLOT_FREE;
+		tx_report_indirect(IEEE802154_INVALID_ADDRESS, slots[slot].handle);
+		return;
+	}
+
+	slots[slot].expiry = mac_time_ovf() + persistence;
+	src_match_set(slot);
+	slots[slot].state = SLOT_QUEUED;
+}
+
+__bit
+indirect_purge(u8 handle)
+{
+	LOGDX8(__func__, handle);
+
+	u8 slot = 0;
+	do {
+		if (slots[slot].state == SLOT_QUEUED && slots[slot].handle == handle) {
+			src_match_clear(slot);
+			slots[slot].state = SLOT_FREE;
+			return 1;
+		}
+	} while (++slot < CONFIG_INDIRECT_QUEUE_LEN);
+
+	return 0;
+}
+
+// The radio sets frame pending in the ACK to a data request from an enabled
+// entry's address, and reports the match, before the ACK is sent
+static u8
+find_slot_for_data_request(void)
+{
+	if (!(RADIO.srcresindex & SRC_MATCH_RES_AUTOPEND))
+		return NO_SLOT;
+
+	u8 slot = 0;
+	do {
+		u8 bit = SLOT_ENTRY(slot) * 2;
+
+		if (slots[slot].state == SLOT_QUEUED && (RADIO.srcresmask[bit >> 3] & BIT(bit & 7)))
+			return slot;
+	} while (++slot < CONFIG_INDIRECT_QUEUE_LEN);
+
+	return NO_SLOT;
+}
+
+void
+indirect_rx_pkt_done(void)
+{
+	// The ACK to any data request we were waiting for is long gone
+	if (armed_slot != NO_SLOT) {
+		slots[armed_slot].state = SLOT_QUEUED;
+		armed_slot = NO_SLOT;
+		tx_busy = 0;
+	}
+
+	if (tx_busy)
+		return;
+
+	u8 slot = find_slot_for_data_request();
+	if (slot == NO_SLOT)
+		return;
+
+	LOGDX8(__func__, slots[slot].handle);
+
+	u8 len = slots[slot].len;
+	if (tx_prepare(len))
+		return;
+
+	__xdata u8 * frame = slots[slot].frame;
+	do {
+		RFD = *frame++;
+	} while (--len);
+
+	slots[slot].state = SLOT_SENDING;
+	armed_slot = slot;
+	armed_time = mac_time_ovf();
+}
+
+void
+indirect_ack_sent(void)
+{
+	if (armed_slot == NO_SLOT)
+		return;
+
+	active_slot = armed_slot;
+	armed_slot = NO_SLOT;
+
+	tx_now();
+}
+
+__bit
+indirect_tx_done(u8 * handle)
+{
+	u8 slot = active_slot;
+	if (slot == NO_SLOT)
+		return 0;
+
+	active_slot = NO_SLOT;
+
+	src_match_clear(slot);
+	slots[slot].state = SLOT_FREE;
+	*handle = slots[slot].handle;
+
+	LOGDX8("indirect done", *handle);
+
+	return 1;
+}
+
+__bit
+indirect_tx_busy(void)
+{
+	return armed_slot != NO_SLOT || active_slot != NO_SLOT;
+}
+
+void
+indirect_poll(void)
+{
+	u16 now = mac_time_ovf();
+
+	u8 slot = 0;
+	do {
+		__critical {
+			if (slots[slot].state == SLOT_QUEUED && (s16)(now - slots[slot].expiry) >= 0)
+				slot_done(slot, IEEE802154_TRANSACTION_EXPIRED);
+		}
+	} while (++slot < CONFIG_INDIRECT_QUEUE_LEN);
+
+	__critical {
+		if (armed_slot != NO_SLOT && (s16)(now - armed_time) > ACK_TIMEOUT) {
+			// The data request was not ACKed with frame pending after all
+			slots[armed_slot].state = SLOT_QUEUED;
+			armed_slot = NO_SLOT;
+			tx_busy = 0;
+		}
+	}
+}
@@ -0,0 +1,36 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "int.h"
+
+// Largest MPDU we can queue, excluding FCS (added by radio)
+#define INDIRECT_MAX_LEN 125
+
+u8 __xdata *
+indirect_enqueue_begin(u8 handle, u16 persistence, u16 len);
+
+void
+indirect_enqueue_done(void);
+
+__bit
+indirect_purge(u8 handle);
+
+// Call this when a frame has been received, before it's ACKed
+void
+indirect_rx_pkt_done(void);
+
+void
+indirect_ack_sent(void);
+
+// Returns 1 and the handle of the frame, if the frame just sent was indirect
+__bit
+indirect_tx_done(u8 * handle);
+
+__bit
+indirect_tx_busy(void);
+
+// Call this periodically from normal context to expire queued frames
+void
+indirect_poll(void);
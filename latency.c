@@ -0,0 +1,147 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "int.h"
+#include "log.h"
+#include "mac_time.h"
+
+#include "latency.h"
+
+// The SFD capture register only holds the time of the latest frame, while
+// frames can wait in rx fifo for usb. So the SFD time of every accepted
+// frame is queued here, in rx fifo order.
+//
+// If the queue is full, the time of that frame (and every later one,
+// until the queue is empty) is skipped, so order is kept.
+
+// Enough for a full rx fifo of short frames
+#define RX_QUEUE_LEN 16
+
+// MAC timer ticks per us
+#define TICKS_PER_US 32
+
+static __xdata struct latency hist;
+static __xdata struct latency snapshot;
+
+static __xdata u32 rx_queue[RX_QUEUE_LEN];
+static u8 rx_head;
+static u8 rx_count;
+static u8 rx_skip;
+
+static __xdata u32 tx_request_time;
+static __bit tx_pending;
+
+static u8
+log2_bucket(u32 ticks)
+{
+	u32 us = ticks / TICKS_PER_US;
+
+	u8 bucket = 0;
+	while (us >>= 1) {
+		if (++bucket == LATENCY_BUCKETS - 1)
+			break;
+	}
+	return bucket;
+}
+
+void
+latency_rx_accepted(void)
+{
+	if (rx_skip || rx_count == RX_QUEUE_LEN) {
+		rx_skip++;
+		return;
+	}
+
+	u8 i = rx_head + rx_count;
+	if (i >= RX_QUEUE_LEN)
+		i -= RX_QUEUE_LEN;
+
+	rx_queue[i] = mac_time_sfd();
+	rx_count++;
+}
+
+static __bit
+rx_pop(u32 * sfd)
+{
+	if (!rx_count) {
+		if (rx_skip)
+			rx_skip--;
+		return 0;
+	}
+
+	*sfd = rx_queue[rx_head];
+	if (++rx_head == RX_QUEUE_LEN)
+		rx_head = 0;
+	rx_count--;
+
+	return 1;
+}
+
+void
+latency_rx_delivered(void)
+{
+	u32 sfd;
+	if (rx_pop(&sfd))
+		hist.rx[log2_bucket(mac_time_diff(mac_time_now(), sfd))]++;
+}
+
+void
+latency_rx_dropped(void)
+{
+	u32 sfd;
+	(void)rx_pop(&sfd);
+}
+
+void
+latency_rx_flushed(void)
+{
+	__critical {
+		rx_head = 0;
+		rx_count = 0;
+		rx_skip = 0;
+	}
+}
+
+void
+latency_tx_request(void)
+{
+	tx_request_time = mac_time_now();
+	tx_pending = 1;
+}
+
+void
+latency_tx_sent(void)
+{
+	if (!tx_pending)
+		return;
+
+	tx_pending = 0;
+	hist.tx[log2_bucket(mac_time_diff(mac_time_sfd(), tx_request_time))]++;
+}
+
+const __xdata struct latency *
+latency_snapshot(__bit reset)
+{
+	__critical {
+		hist.version = LATENCY_VERSION;
+		hist.buckets = LATENCY_BUCKETS;
+
+		const __xdata u8 * src = (const __xdata u8 *)&hist;
+		__xdata u8 * dst = (__xdata u8 *)&snapshot;
+		u8 n = sizeof(hist);
+		do {
+			*dst++ = *src++;
+		} while (--n);
+
+		if (reset) {
+			dst = (__xdata u8 *)&hist;
+			n = sizeof(hist);
+			do {
+				*dst++ = 0;
+			} while (--n);
+		}
+	}
+
+	return &snapshot;
+}
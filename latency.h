@@ -0,0 +1,47 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "int.h"
+
+#define LATENCY_VERSION 1
+
+// Bucket n counts latencies of 2^n to 2^(n+1)-1 us. Last bucket counts the rest.
+#define LATENCY_BUCKETS 16
+
+struct latency {
+	u8 version;   // LATENCY_VERSION
+	u8 buckets;   // LATENCY_BUCKETS
+	u16 _reserved;
+	u32 rx[LATENCY_BUCKETS];  // From SFD of received frame, to frame handed to usb
+	u32 tx[LATENCY_BUCKETS];  // From transmit request, to SFD of transmitted frame
+};
+
+// Call this when a frame has been accepted by the radio, i.e. its SFD has been captured
+void
+latency_rx_accepted(void);
+
+// Call this when the first frame in rx fifo has been handed to usb
+void
+latency_rx_delivered(void);
+
+// Call this when the first frame in rx fifo has been dropped
+void
+latency_rx_dropped(void);
+
+// Call this when rx fifo has been flushed
+void
+latency_rx_flushed(void);
+
+// Call this when a transmit request from host arrives
+void
+latency_tx_request(void);
+
+// Call this when a frame requested by host has been sent
+void
+latency_tx_sent(void);
+
+// Returns a copy of the histograms. Histograms are reset if reset is set.
+const __xdata struct latency *
+latency_snapshot(__bit reset);
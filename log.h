@@ -55,6 +55,20 @@
 	#define LOGEX16(_str, _n)
 #endif
 
+#ifdef LOG_TOKENIZED
+
+// Log string is identified by its address in code memory. See log.S
+#define __LOG_STR(_lvl_char, _str, _endchar) \
+	log_tok_ ## _lvl_char ## 0 ((u16)(_str))
+
+#define __LOG_STR_HEX8(_lvl_char, _str, _n) \
+	log_tok_ ## _lvl_char ## 8 ((u16)(_str) | ((u32)(u8)(_n) << 16))
+
+#define __LOG_STR_HEX16(_lvl_char, _str, _n) \
+	log_tok_ ## _lvl_char ## 16 ((u16)(_str) | ((u32)(u16)(_n) << 16))
+
+#else
+
 #define __LOG_STR(_lvl_char, _str, _endchar) \
 	log_ ## _lvl_char ## _s_ ## _endchar (_str)
 
@@ -70,6 +84,8 @@
 		puthex16(_n);                                                          \
 	}
 
+#endif
+
 #pragma callee_saves putchar
 void
 putchar(char c);
@@ -129,3 +145,55 @@ log_W_s_cl(const __code char * str);
 #pragma callee_saves log_E_s_cl
 void
 log_E_s_cl(const __code char * str);
+
+#ifdef LOG_TOKENIZED
+
+#pragma callee_saves log_tok_D0
+void
+log_tok_D0(u16 id);
+
+#pragma callee_saves log_tok_I0
+void
+log_tok_I0(u16 id);
+
+#pragma callee_saves log_tok_W0
+void
+log_tok_W0(u16 id);
+
+#pragma callee_saves log_tok_E0
+void
+log_tok_E0(u16 id);
+
+#pragma callee_saves log_tok_D8
+void
+log_tok_D8(u32 id_arg);
+
+#pragma callee_saves log_tok_I8
+void
+log_tok_I8(u32 id_arg);
+
+#pragma callee_saves log_tok_W8
+void
+log_tok_W8(u32 id_arg);
+
+#pragma callee_saves log_tok_E8
+void
+log_tok_E8(u32 id_arg);
+
+#pragma callee_saves log_tok_D16
+void
+log_tok_D16(u32 id_arg);
+
+#pragma callee_saves log_tok_I16
+void
+log_tok_I16(u32 id_arg);
+
+#pragma callee_saves log_tok_W16
+void
+log_tok_W16(u32 id_arg);
+
+#pragma callee_saves log_tok_E16
+void
+log_tok_E16(u32 id_arg);
+
+#endif
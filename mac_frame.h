@@ -0,0 +1,89 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "bsp/bits.h"
+#include "int.h"
+
+// IEEE 802.15.4 MAC header parsing
+
+enum mac_frame_type {
+	MAC_FRAME_TYPE_BEACON = 0,
+	MAC_FRAME_TYPE_DATA   = 1,
+	MAC_FRAME_TYPE_ACK    = 2,
+	MAC_FRAME_TYPE_CMD    = 3,
+};
+
+enum mac_addr_mode {
+	MAC_ADDR_MODE_NONE  = 0,
+	MAC_ADDR_MODE_SHORT = 2,
+	MAC_ADDR_MODE_EXT   = 3,
+};
+
+enum mac_cmd {
+	MAC_CMD_DATA_REQUEST = 0x04,
+};
+
+#define MAC_FCF_TYPE(_fcf)          ((_fcf) & 0x7)
+#define MAC_FCF_SECURITY            BIT(3)
+#define MAC_FCF_FRAME_PENDING       BIT(4)
+#define MAC_FCF_ACK_REQUEST         BIT(5)
+#define MAC_FCF_PANID_COMPRESSION   BIT(6)
+#define MAC_FCF_DST_ADDR_MODE(_fcf) (((_fcf) >> 10) & 0x3)
+#define MAC_FCF_SRC_ADDR_MODE(_fcf) (((_fcf) >> 14) & 0x3)
+
+// Offsets into MPDU
+#define MAC_FCF_OFFSET     0
+#define MAC_DSN_OFFSET     2
+#define MAC_DST_PAN_OFFSET 3
+#define MAC_DST_OFFSET     5
+
+inline u8
+mac_addr_len(u8 mode)
+{
+	if (mode == MAC_ADDR_MODE_EXT)
+		return 8;
+	if (mode == MAC_ADDR_MODE_SHORT)
+		return 2;
+	return 0;
+}
+
+// Offset of the source fields, right after the destination fields.
+// Destination PAN ID and address are both left out if there's no address.
+inline u8
+mac_src_fields_offset(u16 fcf)
+{
+	u8 dst_len = mac_addr_len(MAC_FCF_DST_ADDR_MODE(fcf));
+
+	return dst_len ? MAC_DST_OFFSET + dst_len : MAC_DST_PAN_OFFSET;
+}
+
+// Offset of source PAN ID. Same as destination PAN ID, if compressed.
+inline u8
+mac_src_pan_offset(u16 fcf)
+{
+	if (fcf & MAC_FCF_PANID_COMPRESSION)
+		return MAC_DST_PAN_OFFSET;
+
+	return mac_src_fields_offset(fcf);
+}
+
+// Offset of source address. Source PAN ID comes first, unless compressed.
+inline u8
+mac_src_offset(u16 fcf)
+{
+	u8 offset = mac_src_fields_offset(fcf);
+
+	if (!(fcf & MAC_FCF_PANID_COMPRESSION) && MAC_FCF_SRC_ADDR_MODE(fcf))
+		offset += 2;
+
+	return offset;
+}
+
+// Length of MAC header without auxiliary security header
+inline u8
+mac_hdr_len(u16 fcf)
+{
+	return mac_src_offset(fcf) + mac_addr_len(MAC_FCF_SRC_ADDR_MODE(fcf));
+}
@@ -0,0 +1,104 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "bsp/mac_timer.h"
+
+#include "int.h"
+#include "log.h"
+
+#include "mac_time.h"
+
+// The MAC timer is started once and never stopped or reset, so it can be
+// used as a common time base. The CSP only cares about overflow events,
+// i.e. CSMA back-off periods.
+
+void
+mac_time_setup(void)
+{
+	LOGD(__func__);
+
+	// Stop mac timer
+	T2CTRL = 0;
+
+	mac_timer_set_period(MAC_TIMER_PERIOD);
+
+	// Don't reset overflow count (use long overflow period)
+	mac_timer_select_multiplexed_regs(T2M_TIMER, T2OVF_PERIOD);
+	T2MOVF0 = 0xff;
+	T2MOVF1 = 0xff;
+	T2MOVF2 = 0xff;
+
+	// Set overflow compare 1 count to something like 100 ms => 100 overflows
+	mac_timer_select_multiplexed_regs(T2M_TIMER, T2OVF_CMP1);
+	T2MOVF0 = 100;
+	T2MOVF1 = 0;
+	T2MOVF2 = 0;
+
+	// Clear count and overflow count
+	mac_timer_select_multiplexed_regs(T2M_TIMER, T2OVF_OVERFLOW);
+	T2M0 = 0;
+	T2M1 = 0;
+	T2MOVF0 = 0;
+	T2MOVF1 = 0;
+	T2MOVF2 = 0;
+
+	// Start mac timer.
+	// Latch mode: Reading T2M0 latches both T2M1 and the overflow count.
+	T2CTRL = T2CTRL_RUN | T2CTRL_LATCH_MODE;
+}
+
+static u32
+read_multiplexed_regs(void)
+{
+	// Must be called with interrupts disabled, with T2M0 read first
+	u16 cnt = T2M0;
+	cnt |= T2M1 << 8;
+
+	u16 ovf = T2MOVF0;
+	ovf |= T2MOVF1 << 8;
+
+	return ((u32)ovf << 16) | cnt;
+}
+
+u32
+mac_time_now(void)
+{
+	u32 t;
+
+	__critical {
+		mac_timer_select_multiplexed_regs(T2M_TIMER, T2OVF_OVERFLOW);
+		t = read_multiplexed_regs();
+	}
+
+	return t;
+}
+
+u32
+mac_time_sfd(void)
+{
+	// The MAC timer is captured on every start of frame delimiter, rx or tx
+	u32 t;
+
+	__critical {
+		mac_timer_select_multiplexed_regs(T2M_CAPTURE, T2OVF_CAPTURE);
+		t = read_multiplexed_regs();
+	}
+
+	return t;
+}
+
+u16
+mac_time_ovf(void)
+{
+	return MAC_TIME_OVF(mac_time_now());
+}
+
+u32
+mac_time_diff(u32 later, u32 earlier)
+{
+	u16 ovf = MAC_TIME_OVF(later) - MAC_TIME_OVF(earlier);
+	s32 cnt = (s32)MAC_TIME_CNT(later) - MAC_TIME_CNT(earlier);
+
+	return (u32)ovf * MAC_TIMER_PERIOD + cnt;
+}
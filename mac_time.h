@@ -0,0 +1,39 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "int.h"
+
+// NOTE: Apparently mac timer is fed from 32MHz clock undivided!
+// Symbol rate: 62.5k/s => symbol period: 16us
+// 32MHz / 62.5Khz = 512 ticks
+#define MAC_TIMER_SYMBOL_PERIOD (32000000/62500)
+
+// CSMA BACK-OFF PERIOD:
+// aUnitBackoffPeriod = aTurnaroundTime + aCcaTime.
+// aTurnaroundTime = 1ms (1 ms expressed in symbol periods, rounded up to the next integer number of symbol periods)
+// aCcaTime = 8 symbol periods
+#define MAC_TIMER_PERIOD ((8 + 63)*MAC_TIMER_SYMBOL_PERIOD)
+
+// MAC time stamps are 32 bits:
+// Overflow count (in units of MAC_TIMER_PERIOD) in the upper 16 bits,
+// timer count (in units of 1/32 us) in the lower 16 bits.
+#define MAC_TIME_OVF(_t) ((u16)((_t) >> 16))
+#define MAC_TIME_CNT(_t) ((u16)(_t))
+
+void
+mac_time_setup(void);
+
+u32
+mac_time_now(void);
+
+u32
+mac_time_sfd(void);
+
+u16
+mac_time_ovf(void);
+
+// Ticks from earlier to later, assuming less than 2^16 overflows apart
+u32
+mac_time_diff(u32 later, u32 earlier);
@@ -9,10 +9,18 @@
 #include "bsp/interrupts.h"
 #include "bsp/radio.h"
 #include "bsp/watchdog.h"
+#include "boot_timeline.h"
 #include "config/pins.h"
+#include "flash_config.h"
+#include "indirect.h"
 #include "int.h"
 #include "log.h"
+#include "mac_time.h"
+#include "mem_usage.h"
+#include "profile.h"
 #include "radio.h"
+#include "trace.h"
+#include "tx_report.h"
 #include "uart.h"
 #include "usb.h"
 
@@ -43,22 +51,39 @@ print_csp_state(void)
 int
 main(void)
 {
+	stack_paint();
 	FLASH.ctl = FLASH_CTL_CACHE_MODE_PREFETCH;
 	clk_setup(CLKSPD_32M, TICKSPD_32M, OSC_32MHZ_XTAL, OSC32K_RC);
+	mac_time_setup();
+	boot_stage(BOOT_CLOCK);
+	trace_setup();
+	profile_setup();
 	pins_setup();
 	uart_setup();
 
 	LOGI("CC2531 WPAN adapter " GIT_VERSION_STR " online!");
 
 	pins_setup();
-	usb_init();
+
+	// Radio first, so it's receiving already while host enumerates us
 	radio_setup();
+	boot_stage(BOOT_RADIO_SETUP);
+	flash_config_apply();
+	boot_stage(BOOT_FLASH_CONFIG);
+
+	usb_init();
+	boot_stage(BOOT_USB_INIT);
 
+	boot_stage(BOOT_RUNNING);
 	interrupts_enable();
 
 	for (;;) {
 		watchdog_feed();
 		maybe_sleep();
+		indirect_poll();
+		flash_config_poll();
+		tx_report_poll();
+		usb_remote_wakeup_poll();
 		print_csp_state();
 	}
 }
@@ -0,0 +1,53 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "int.h"
+
+#include "mem_usage.h"
+
+// Defined in linker_syms.S
+struct linker_mem_areas {
+	u16 xseg;
+	u16 xiseg;
+	u16 pseg;
+	u16 dseg;
+	u16 oseg;
+	u16 iseg;
+	u16 bseg;
+	u16 sseg_start;
+};
+
+extern const __code struct linker_mem_areas linker_mem_areas;
+
+static __xdata struct mem_usage usage;
+
+static u8
+stack_peak(u8 start)
+{
+	// The stack grows up, so look for the highest byte that isn't paint
+	u8 p = 0xff;
+	while (p > start && *(__idata u8 *)p == STACK_PAINT)
+		p--;
+
+	return p;
+}
+
+const __xdata struct mem_usage *
+mem_usage(void)
+{
+	u8 start = linker_mem_areas.sseg_start;
+	u8 peak = stack_peak(start);
+
+	usage.version = MEM_USAGE_VERSION;
+	usage.stack_start = start;
+	usage.stack_peak = peak;
+	usage.stack_free = 0xff - peak;
+
+	usage.xdata = linker_mem_areas.xseg + linker_mem_areas.xiseg + linker_mem_areas.pseg;
+	usage.data = linker_mem_areas.dseg + linker_mem_areas.oseg;
+	usage.idata = linker_mem_areas.iseg;
+	usage.bits = linker_mem_areas.bseg;
+
+	return &usage;
+}
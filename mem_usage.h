@@ -0,0 +1,38 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "int.h"
+
+#define MEM_USAGE_VERSION 1
+
+// Unused stack is filled with this at boot
+#define STACK_PAINT 0xa5
+
+__sfr __at(0x81) STACK_PTR;
+
+struct mem_usage {
+	u8 version;          // MEM_USAGE_VERSION
+	u8 stack_start;      // IDATA address of bottom of stack
+	u8 stack_peak;       // Highest IDATA address ever used by stack
+	u8 stack_free;       // Bytes of stack never used
+	u16 xdata;           // Static XDATA (XSEG, XISEG, PSEG), bytes
+	u16 data;            // Static DATA (DSEG, OSEG), bytes
+	u16 idata;           // Static IDATA (ISEG), bytes
+	u16 bits;            // Static bit variables (BSEG), bits
+};
+
+// Call this first thing in main(), with interrupts disabled
+inline void
+stack_paint(void)
+{
+	// Everything above the stack pointer, up to the top of IDATA
+	u8 p = STACK_PTR + 1;
+	do {
+		*(__idata u8 *)p = STACK_PAINT;
+	} while (++p);
+}
+
+const __xdata struct mem_usage *
+mem_usage(void);
@@ -0,0 +1,143 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "bsp/usb.h"
+
+#include "config/misc.h"
+#include "int.h"
+#include "log.h"
+#include "stats.h"
+#include "usb_config.h"
+
+#include "notify.h"
+
+// Events are queued in a ring buffer, and moved to the status endpoint
+// fifo whenever it has room for another packet, so nothing is overwritten
+// before host has collected it.
+//
+// Every event is stored as { u8 (type << 4) | len; u8 seq; u8 payload[len]; }
+//
+// Packed: As many whole events as fit are sent in each packet, as stored.
+// Otherwise: Only the payload of one event is sent in each packet, just
+// like the status messages of old.
+
+#define RING_MASK (CONFIG_NOTIFY_RING_LEN - 1)
+
+#define HDR_LEN 2
+
+#define EVENT_LEN(_hdr) (HDR_LEN + ((_hdr) & 0xf))
+
+static __xdata u8 ring[CONFIG_NOTIFY_RING_LEN];
+
+// Index of first byte of oldest event, and of next free byte
+static u8 head;
+static u8 tail;
+
+static u8 seq;
+static __bit packed;
+
+void
+notify_set_packed(__bit enable)
+{
+	LOGDX8(__func__, enable);
+	packed = enable;
+}
+
+__bit
+notify_packed(void)
+{
+	return packed;
+}
+
+void
+notify_reset(void)
+{
+	__critical {
+		head = 0;
+		tail = 0;
+	}
+}
+
+static u8
+ring_used(void)
+{
+	return (u8)(tail - head) & RING_MASK;
+}
+
+static void
+send_event(void)
+{
+	u8 hdr = ring[head];
+	u8 n = EVENT_LEN(hdr);
+
+	if (!packed) {
+		// Skip header
+		head = (head + HDR_LEN) & RING_MASK;
+		n -= HDR_LEN;
+	}
+
+	do {
+		USB.fifo[INT_EP].fifo = ring[head];
+		head = (head + 1) & RING_MASK;
+	} while (--n);
+}
+
+static void
+kick(void)
+{
+	if (head == tail)
+		return;
+
+	usb_select_endpoint(INT_EP);
+
+	// Both packet buffers still waiting for host
+	if (USB.in_ep.csil & USBCSIL_INPKT_RDY)
+		return;
+
+	u8 room = INT_EP_MAXPKTSIZE;
+	do {
+		u8 n = EVENT_LEN(ring[head]);
+		if (n > room)
+			break;
+
+		send_event();
+		room -= n;
+	} while (packed && head != tail);
+
+	usb_select_endpoint(INT_EP);
+	USB.in_ep.csil = USBCSIL_INPKT_RDY;
+}
+
+void
+notify_post(u8 type, const __xdata u8 * payload, u8 len)
+{
+	__critical {
+		// One byte is always left unused, to tell full from empty
+		if (ring_used() + HDR_LEN + len >= CONFIG_NOTIFY_RING_LEN) {
+			LOGE("notify: full");
+			STATS_INC(notify_dropped);
+			seq++;
+		} else {
+			ring[tail] = (type << 4) | len;
+			tail = (tail + 1) & RING_MASK;
+			ring[tail] = seq++;
+			tail = (tail + 1) & RING_MASK;
+
+			while (len--) {
+				ring[tail] = *payload++;
+				tail = (tail + 1) & RING_MASK;
+			}
+
+			kick();
+		}
+	}
+}
+
+void
+notify_usb_intr_handler(void)
+{
+	__critical {
+		kick();
+	}
+}
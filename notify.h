@@ -0,0 +1,33 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "int.h"
+
+// Events for host, queued for the status endpoint
+enum notify_type {
+	NOTIFY_STATUS          = 1, // Status byte
+	NOTIFY_INDIRECT_STATUS = 2, // Status byte, frame handle
+	NOTIFY_TX_REPORT       = 3, // struct tx_report
+};
+
+// Non-zero: Pack several events with header in each packet
+void
+notify_set_packed(__bit packed);
+
+__bit
+notify_packed(void);
+
+// Flush queued events. Call when status endpoint is (re)configured.
+void
+notify_reset(void);
+
+// Queue event for host. Payload must fit in a packet with the event header. Never blocks. If queue is full, the event is
+// dropped, which the host sees as a gap in sequence numbers.
+void
+notify_post(u8 type, const __xdata u8 * payload, u8 len);
+
+// Call when status endpoint has sent a packet
+void
+notify_usb_intr_handler(void);
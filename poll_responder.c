@@ -0,0 +1,108 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "bsp/bits.h"
+#include "bsp/radio.h"
+
+#include "int.h"
+#include "log.h"
+#include "mac_frame.h"
+#include "rx.h"
+#include "src_match.h"
+
+#include "poll_responder.h"
+
+// Most data requests from polling devices get "no data".
+// The radio already ACKs them with frame pending from the source address
+// matching table maintained by the host, so when there's nothing pending
+// there's no need to bother the host with the data request at all.
+
+static __bit enabled;
+static __xdata u16 polls_absorbed;
+
+void
+poll_responder_enable(__bit enable)
+{
+	LOGDX8(__func__, enable);
+	enabled = enable;
+}
+
+__bit
+poll_responder_enabled(void)
+{
+	return enabled;
+}
+
+static __bit
+ext_addr_pending(u8 src)
+{
+	u8 entry = 0;
+	do {
+		u8 bit = entry * 2;
+		u8 i = bit >> 3;
+		u8 mask = BIT(bit & 7);
+
+		if (!(RADIO.srcexten[i] & RADIO.srcextpenden[i] & mask))
+			continue;
+
+		if (rx_peek_cmp(SRC_MATCH_TABLE + entry * 8, src, 8))
+			return 1;
+	} while (++entry < SRC_MATCH_EXT_ENTRIES);
+
+	return 0;
+}
+
+static __bit
+short_addr_pending(u8 src_pan, u8 src)
+{
+	u8 entry = 0;
+	do {
+		u8 i = entry >> 3;
+		u8 mask = BIT(entry & 7);
+
+		if (!(RADIO.srcshorten[i] & RADIO.srcshortpenden[i] & mask))
+			continue;
+
+		// PAN ID followed by short address
+		const __xdata u8 * e = SRC_MATCH_TABLE + entry * 4;
+		if (rx_peek_cmp(e, src_pan, 2) && rx_peek_cmp(e + 2, src, 2))
+			return 1;
+	} while (++entry < SRC_MATCH_SHORT_ENTRIES);
+
+	return 0;
+}
+
+__bit
+poll_responder_absorb(void)
+{
+	if (!enabled)
+		return 0;
+
+	u16 fcf = rx_peek_data_request();
+	if (!fcf)
+		return 0;
+
+	// MPDU starts at rx fifo byte 1
+	u8 src_pan = 1 + mac_src_pan_offset(fcf);
+	u8 src = 1 + mac_src_offset(fcf);
+
+	if (MAC_FCF_SRC_ADDR_MODE(fcf) == MAC_ADDR_MODE_EXT) {
+		if (ext_addr_pending(src))
+			return 0;
+	} else {
+		if (short_addr_pending(src_pan, src))
+			return 0;
+	}
+
+	rx_drop();
+	polls_absorbed++;
+
+	return 1;
+}
+
+const __xdata u16 *
+poll_responder_count(void)
+{
+	return &polls_absorbed;
+}
@@ -0,0 +1,18 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "int.h"
+
+void
+poll_responder_enable(__bit enable);
+
+__bit
+poll_responder_enabled(void);
+
+__bit
+poll_responder_absorb(void);
+
+const __xdata u16 *
+poll_responder_count(void);
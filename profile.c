@@ -0,0 +1,151 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "config/profile_budgets.h"
+#include "int.h"
+#include "log.h"
+
+#include "profile.h"
+
+#ifdef PROFILE_ISR
+
+#include "bsp/timers.h"
+
+// Timer 1 runs free at 32 MHz, so ISR run times are in CPU cycles.
+// It wraps every ~2 ms, which is plenty for any ISR.
+
+// In order of enum profile_isr
+static const __code u16 budgets[PROFILE_ISR_COUNT] = {
+	PROFILE_BUDGET_RF,
+	PROFILE_BUDGET_RFERR,
+	PROFILE_BUDGET_USB,
+};
+
+// By bRequest, 0 for none
+static const __code u16 req_budgets[PROFILE_REQ_COUNT] = PROFILE_BUDGET_REQS;
+
+static __xdata struct profile stats;
+static __xdata struct profile snapshot;
+
+static void
+reset_stats(void)
+{
+	__xdata u8 * p = (__xdata u8 *)&stats;
+	u16 n = sizeof(stats);
+	do {
+		*p++ = 0;
+	} while (--n);
+
+	stats.version = PROFILE_VERSION;
+	stats.isr_count = PROFILE_ISR_COUNT;
+	stats.req_count = PROFILE_REQ_COUNT;
+
+	u8 isr = 0;
+	do {
+		stats.isr[isr].min = 0xffff;
+		stats.isr[isr].budget = budgets[isr];
+	} while (++isr < PROFILE_ISR_COUNT);
+
+	u8 req = 0;
+	do {
+		stats.req[req].min = 0xffff;
+	} while (++req < PROFILE_REQ_COUNT);
+}
+
+void
+profile_setup(void)
+{
+	LOGD(__func__);
+
+	reset_stats();
+
+	// Free running, no prescaler
+	T1CTL = T1CTL_DIV_1 | T1CTL_MODE_FREE_RUNNING;
+}
+
+u16
+profile_now(void)
+{
+	// Reading T1CNTL latches T1CNTH
+	u16 t = T1CNTL;
+	return t | (T1CNTH << 8);
+}
+
+static u8
+log2_bucket(u16 cycles)
+{
+	u8 bucket = 0;
+	while (cycles >>= 1)
+		bucket++;
+	return bucket;
+}
+
+void
+profile_isr_done(u8 isr, u16 start)
+{
+	u16 cycles = profile_now() - start;
+	__xdata struct profile_isr_stats * s = &stats.isr[isr];
+
+	s->count++;
+	s->total += cycles;
+
+	if (cycles < s->min)
+		s->min = cycles;
+
+	if (cycles > s->max)
+		s->max = cycles;
+
+	s->hist[log2_bucket(cycles)]++;
+
+	if (cycles > s->budget)
+		s->over_budget++;
+}
+
+void
+profile_req_done(const struct usb_setup * setup, u16 start)
+{
+	u16 cycles = profile_now() - start;
+	u8 rt = setup->bmRequestType;
+	u8 req = setup->bRequest;
+
+	if (rt != USB_RT_VENDOR_DEV_IN && rt != USB_RT_VENDOR_DEV_OUT)
+		return;
+	if (req >= PROFILE_REQ_COUNT)
+		return;
+
+	__xdata struct profile_req_stats * s = &stats.req[req];
+
+	s->count++;
+	s->total += cycles;
+
+	if (cycles < s->min)
+		s->min = cycles;
+
+	if (cycles > s->max)
+		s->max = cycles;
+
+	u16 budget = req_budgets[req];
+	if (budget && cycles > budget)
+		s->over_budget++;
+}
+
+const __xdata struct profile *
+profile_snapshot(__bit reset)
+{
+	__critical {
+		const __xdata u8 * src = (const __xdata u8 *)&stats;
+		__xdata u8 * dst = (__xdata u8 *)&snapshot;
+		u16 n = sizeof(stats);
+		do {
+			*dst++ = *src++;
+		} while (--n);
+
+		if (reset)
+			reset_stats();
+	}
+
+	return &snapshot;
+}
+
+#endif
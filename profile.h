@@ -0,0 +1,90 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "int.h"
+#include "usb/ctrl.h"
+
+// ISR cycle profiler. Build with PROFILE_ISR=1 to enable.
+// Compiled out, PROFILE_ISR_ENTER/EXIT and PROFILE_REQ_ENTER/EXIT cost nothing.
+
+enum profile_isr {
+	PROFILE_ISR_RF,
+	PROFILE_ISR_RFERR,
+	PROFILE_ISR_USB,
+	PROFILE_ISR_COUNT,
+};
+
+// Vendor requests, by bRequest, are profiled within the usb isr
+#define PROFILE_REQ_COUNT (USB_REQ_VENDOR_GET_BOOT_TIMELINE + 1)
+
+#define PROFILE_VERSION 3
+
+// Bucket n counts ISR runs of 2^n to 2^(n+1)-1 cycles
+#define PROFILE_HIST_BUCKETS 16
+
+struct profile_isr_stats {
+	u16 count;
+	u16 min;      // Cycles (32 MHz)
+	u16 max;
+	u32 total;
+	u16 hist[PROFILE_HIST_BUCKETS];
+	u16 budget;   // Cycles, PROFILE_BUDGET_* in config/profile_budgets.h
+	u16 over_budget;
+};
+
+// The setup handler, and the completion handler after the data stage, are
+// counted as a run each
+struct profile_req_stats {
+	u16 count;
+	u16 min;      // Cycles (32 MHz)
+	u16 max;
+	u32 total;
+	u16 over_budget;
+};
+
+struct profile {
+	u8 version;   // PROFILE_VERSION
+	u8 isr_count; // PROFILE_ISR_COUNT
+	u8 req_count; // PROFILE_REQ_COUNT
+	struct profile_isr_stats isr[PROFILE_ISR_COUNT];
+	struct profile_req_stats req[PROFILE_REQ_COUNT];
+};
+
+#ifdef PROFILE_ISR
+
+#define PROFILE_ISR_ENTER() u16 profile_start = profile_now()
+#define PROFILE_ISR_EXIT(_isr) profile_isr_done(_isr, profile_start)
+
+#define PROFILE_REQ_ENTER() u16 profile_req_start = profile_now()
+#define PROFILE_REQ_EXIT(_setup) profile_req_done(_setup, profile_req_start)
+
+void
+profile_setup(void);
+
+u16
+profile_now(void);
+
+void
+profile_isr_done(u8 isr, u16 start);
+
+// Only vendor requests are counted
+void
+profile_req_done(const struct usb_setup * setup, u16 start);
+
+// Returns a copy of stats. Stats are reset if reset is set.
+const __xdata struct profile *
+profile_snapshot(__bit reset);
+
+#else
+
+#define PROFILE_ISR_ENTER()
+#define PROFILE_ISR_EXIT(_isr)
+
+#define PROFILE_REQ_ENTER()
+#define PROFILE_REQ_EXIT(_setup)
+
+#define profile_setup()
+
+#endif
@@ -11,8 +11,12 @@
 #include "bsp/gpio.h"
 
 #include "config/pins.h"
+#include "latency.h"
 #include "log.h"
+#include "profile.h"
 #include "rx.h"
+#include "stats.h"
+#include "trace.h"
 #include "tx.h"
 
 void
@@ -65,44 +69,57 @@ radio_setup(void)
 
 INTERRUPT(rferr_isr, INTR_RFERR)
 {
+	PROFILE_ISR_ENTER();
+
 	TCON_RFERRIF = 0;
 
 	u8 flags = RFERRF;
 	RFERRF = 0;
 
+	trace(TRACE_RFERR, flags);
+
 	if (flags & RFERRF_NLOCK) {
 		// Frequency synthesizer failed to achieve lock after time-out, or lock is lost during reception
 		// Receiver must be restarted to clear this error situation.
 		RFST = CSP_IMM_CMD_STROBE(CSP_CMD_RXON);
+		STATS_INC(rx_nlock);
 		LOGE("nlock");
 	}
 	
 	if (flags & RFERRF_RXABO) {
 		RFST = CSP_IMM_CMD_STROBE(CSP_CMD_FLUSHRX);
+		latency_rx_flushed();
+		STATS_INC(rx_aborts);
 		LOGE("rxabo");
 	}
 	
 	if (flags & RFERRF_RXOVERF) {
 		RFST = CSP_IMM_CMD_STROBE(CSP_CMD_FLUSHRX);
+		latency_rx_flushed();
 		RFST = CSP_IMM_CMD_STROBE(CSP_CMD_RXON);
+		STATS_INC(rx_overflows);
 		LOGE("rx overflow");
 	}
 	
 	if (flags & RFERRF_RXUNDERF) {
 		RFST = CSP_IMM_CMD_STROBE(CSP_CMD_FLUSHRX);
+		latency_rx_flushed();
 		RFST = CSP_IMM_CMD_STROBE(CSP_CMD_RXON);
+		STATS_INC(rx_underflows);
 		LOGE("rx underflow");
 	}
 	
 	if (flags & RFERRF_TXOVERF) {
 		RFST = CSP_IMM_CMD_STROBE(CSP_CMD_FLUSHTX);
-		usb_status_send(IEEE802154_TRANSACTION_OVERFLOW);
+		tx_done(IEEE802154_TRANSACTION_OVERFLOW);
+		STATS_INC(tx_errors);
 		LOGE("tx overflow");
 	}
 	
 	if (flags & RFERRF_TXUNDERF) {
 		RFST = CSP_IMM_CMD_STROBE(CSP_CMD_FLUSHTX);
-		usb_status_send(IEEE802154_SYSTEM_ERROR);
+		tx_done(IEEE802154_SYSTEM_ERROR);
+		STATS_INC(tx_errors);
 		LOGE("tx underflow");
 	}
 	
@@ -110,12 +127,17 @@ INTERRUPT(rferr_isr, INTR_RFERR)
 		// A command strobe was issued at a time it could not be processed.
 		// Triggered if trying to disable radio when already disabled,
 		// or when trying to do a SACK, SACKPEND, or SNACK command when not in active RX.
+		STATS_INC(strobe_errors);
 		LOGE("strobe err");
 	}
+
+	PROFILE_ISR_EXIT(PROFILE_ISR_RFERR);
 }
 
 INTERRUPT(rf_isr, INTR_RF)
 {
+	PROFILE_ISR_ENTER();
+
 	// clear interrupt flags
 	S1CON = 0;
 
@@ -129,9 +151,14 @@ INTERRUPT(rf_isr, INTR_RF)
 
 	masked_flags = RFIRQF0 & RADIO.rfirqm0;
 	if (masked_flags) {
-		RFIRQF0 = 0;
+		// Clear only the flags handled here. The ones masked, such as FIFOP
+		// while usb is busy, stay pending, and fire once they're unmasked.
+		// See enable_radio_pkt_ready_intr() in rx.c
+		RFIRQF0 = ~masked_flags;
 		rx_radio_intr_handler(masked_flags);
 	}
+
+	PROFILE_ISR_EXIT(PROFILE_ISR_RF);
 }
 
 void
@@ -143,4 +170,5 @@ radio_stop(void)
 		RFST = CSP_IMM_CMD_STROBE(CSP_CMD_RFOFF);
 
 	RFST = CSP_IMM_CMD_STROBE(CSP_CMD_FLUSHRX);
+	latency_rx_flushed();
 }
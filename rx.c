@@ -6,24 +6,72 @@
 #include "bsp/usb.h"
 #include "bsp/radio.h"
 
+#include "boot_timeline.h"
+#include "config/misc.h"
 #include "int.h"
+#include "indirect.h"
+#include "latency.h"
 #include "log.h"
+#include "mac_frame.h"
+#include "poll_responder.h"
+#include "stats.h"
+#include "trace.h"
+#include "tx_report.h"
+#include "usb.h"
 #include "usb_config.h"
 
-#define enable_radio_pkt_ready_intr()  { RADIO.rfirqm0 = RFIRQF0_FIFOP; }
-#define disable_radio_pkt_ready_intr() { RADIO.rfirqm0 = 0; }
+#include "rx.h"
+
+// The rx fifo is memory mapped in radio RAM
+static __xdata __at(0x6000) u8 rxfifo[128];
+
+#define disable_radio_pkt_ready_intr() { RADIO.rfirqm0 &= ~RFIRQF0_FIFOP; }
+
+// A FIFOP flag left pending while masked may be for a frame that has been
+// popped since, so clear it, and go by the FIFOP signal instead. Only called
+// with the rf interrupt unable to preempt us.
+static void
+enable_radio_pkt_ready_intr(void)
+{
+	RFIRQF0 = ~RFIRQF0_FIFOP;
+	RADIO.rfirqm0 |= RFIRQF0_FIFOP;
+
+	// Frames completed while masked won't raise the flag again
+	if (RADIO.fsmstat1.fifop)
+		rx_radio_intr_handler(RFIRQF0_FIFOP);
+}
+
+// Frame types that wake up a suspended host
+static u8 wake_filter = 0xff;
+
+// Set while the frame at the head of the rx fifo is held back for remote
+// wakeup. It's been looked at already, so it isn't again when delivered.
+static __bit held;
+
+// Fast boot: Frames received before host has configured us are held here,
+// as { phy header, frame } ..., and delivered as soon as it has.
+static __bit early;
+static __xdata u8 early_buf[CONFIG_RX_EARLY_BUF_LEN];
+static u16 early_len;
+static u16 early_pos;
 
 inline void
 setup_radio_rx(void)
 {
 	RFST = CSP_IMM_CMD_STROBE(CSP_CMD_FLUSHRX);
 	RFST = CSP_IMM_CMD_STROBE(CSP_CMD_FLUSHRX);
+	latency_rx_flushed();
+	held = 0;
 	
 	// Clear intr flags
 	RFIRQF0 = 0;
 
 	// We only want an interrupt when a complete frame has been received
 	RADIO.fifop_thr = 127;
+
+	// Always get SFD time of accepted frames, for latency measurement,
+	// and data requests as soon as they're received, before they're ACKed
+	RADIO.rfirqm0 = RFIRQF0_FRAME_ACCEPTED | RFIRQF0_RXPKTDONE;
 }
 
 inline void
@@ -42,14 +90,160 @@ setup_usb_rx_endpoint(void)
 	USB.iie |= BIT(RXPKT_EP);
 }
 
+static __bit
+rx_early_deliver(void);
+
 void
 rx_setup(void)
 {
 	LOGI(__func__);
 	setup_usb_rx_endpoint();
+
+	// After fast boot, radio is already receiving, and frames may be held back
+	disable_radio_pkt_ready_intr();
+	if (early) {
+		early = 0;
+		if (rx_early_deliver())
+			return;
+	} else {
+		setup_radio_rx();
+	}
+
+	enable_radio_pkt_ready_intr();
+}
+
+void
+rx_early_start(void)
+{
+	LOGI(__func__);
 	setup_radio_rx();
 
+	early = 1;
+	early_len = 0;
+	early_pos = 0;
+
 	enable_radio_pkt_ready_intr();
+	RFST = CSP_IMM_CMD_STROBE(CSP_CMD_RXON);
+}
+
+__bit
+rx_early_active(void)
+{
+	return early;
+}
+
+u8
+rx_peek(u8 n)
+{
+	return rxfifo[(u8)(RADIO.rxfirst_ptr + n) & 0x7f];
+}
+
+__bit
+rx_peek_cmp(const __xdata u8 * p, u8 n, u8 len)
+{
+	do {
+		if (*p++ != rx_peek(n++))
+			return 0;
+	} while (--len);
+
+	return 1;
+}
+
+u16
+rx_peek_data_request(void)
+{
+	// MPDU starts at byte 1
+	u8 len = rx_peek(0) & 0x7f;
+	if (len < 3)
+		return 0;
+
+	u16 fcf = rx_peek(1 + MAC_FCF_OFFSET) | (rx_peek(2 + MAC_FCF_OFFSET) << 8);
+
+	if (MAC_FCF_TYPE(fcf) != MAC_FRAME_TYPE_CMD)
+		return 0;
+
+	// Can't see the command ID of a secured frame
+	if (fcf & MAC_FCF_SECURITY)
+		return 0;
+
+	if (!(fcf & MAC_FCF_ACK_REQUEST) || !MAC_FCF_SRC_ADDR_MODE(fcf))
+		return 0;
+
+	// Command ID and FCS must follow MAC header
+	u8 hdr_len = mac_hdr_len(fcf);
+	if (len < hdr_len + 3)
+		return 0;
+
+	if (rx_peek(1 + hdr_len) != MAC_CMD_DATA_REQUEST)
+		return 0;
+
+	return fcf;
+}
+
+void
+rx_drop(void)
+{
+	u8 len = RFD & 0x7f;
+	do {
+		(void)RFD;
+	} while (--len);
+
+	latency_rx_dropped();
+}
+
+static void
+rx_early_store(void)
+{
+	u8 len = rx_peek(0) & 0x7f;
+
+	if (early_len + 1 + len > CONFIG_RX_EARLY_BUF_LEN) {
+		rx_drop();
+		return;
+	}
+
+	boot_stage(BOOT_FIRST_RX);
+	trace(TRACE_RX_FRAME, len);
+
+	__xdata u8 * p = &early_buf[early_len];
+	early_len += 1 + len;
+
+	*p++ = RFD & 0x7f;
+
+	u8 b;
+	do {
+		b = RFD;
+		*p++ = b;
+	} while (--len);
+
+	STATS_INC(rx_frames);
+	if (!(b & 0x80))
+		STATS_INC(rx_crc_errors);
+
+	// Way too late to count, once delivered
+	latency_rx_dropped();
+}
+
+// Hand the next held back frame to usb. Returns 0 if there are none left.
+static __bit
+rx_early_deliver(void)
+{
+	if (early_pos == early_len)
+		return 0;
+
+	__xdata u8 * p = &early_buf[early_pos];
+	u8 len = *p++;
+	early_pos += 1 + len;
+
+	do {
+		USB.fifo[RXPKT_EP].fifo = *p++;
+	} while (--len);
+
+	boot_stage(BOOT_FIRST_FRAME);
+
+	usb_select_endpoint(RXPKT_EP);
+	USB.in_ep.csil = USBCSIL_INPKT_RDY;
+
+	return 1;
 }
 
 inline void
@@ -59,26 +253,92 @@ rx_pkt(void)
 
 	// pop phy header (frame length) from fifo
 	u8 len = RFD & 0x7f;
+	trace(TRACE_RX_FRAME, len);
+
+	// Last byte is CRC_OK and correlation
+	u8 b;
 	do {
-		USB.fifo[RXPKT_EP].fifo = RFD;
+		b = RFD;
+		USB.fifo[RXPKT_EP].fifo = b;
 	} while (--len);
 
+	STATS_INC(rx_frames);
+	if (!(b & 0x80))
+		STATS_INC(rx_crc_errors);
+
 	// Tell usb hw there's a packet to send
 	usb_select_endpoint(RXPKT_EP);
 	USB.in_ep.csil = USBCSIL_INPKT_RDY;
+
+	latency_rx_delivered();
+	boot_stage(BOOT_FIRST_RX);
+	boot_stage(BOOT_FIRST_FRAME);
 }
 
 void
 rx_radio_intr_handler(u8 flags)
 {
-	if (flags & RFIRQF0_FIFOP) {
-		// A complete frame has been received
+	if (flags & RFIRQF0_FRAME_ACCEPTED)
+		latency_rx_accepted();
+
+	if (flags & RFIRQF0_RXPKTDONE)
+		indirect_rx_pkt_done();
+
+	if (!(flags & RFIRQF0_FIFOP))
+		return;
+
+	// A complete frame has been received, unless the flag was left pending
+	// for a frame already popped by an earlier pass
+	while (RADIO.fsmstat1.fifop) {
+		if (!held)
+			tx_report_rx_frame();
+		held = 0;
+
+		// Absorbed polls never reach usb, so go on with the next frame, if any
+		if (poll_responder_absorb())
+			continue;
+
+		if (early) {
+			rx_early_store();
+			continue;
+		}
+
+		if (usb_remote_wakeup_armed()) {
+			if (!(wake_filter & BIT(MAC_FCF_TYPE(rx_peek(1 + MAC_FCF_OFFSET))))) {
+				rx_drop();
+				continue;
+			}
+
+			// Keep frame in rx fifo, until host has resumed
+			held = 1;
+			disable_radio_pkt_ready_intr();
+			usb_remote_wakeup_request();
+			return;
+		}
+
 		rx_pkt();
 		// Disable this interrupt until usb fifo is empty
 		disable_radio_pkt_ready_intr();
+		return;
 	}
 }
 
+void
+rx_resume(void)
+{
+	usb_select_endpoint(RXPKT_EP);
+
+	if (!USB.in_ep.csil)
+		enable_radio_pkt_ready_intr();
+}
+
+void
+rx_set_wake_filter(u8 frame_types)
+{
+	LOGDX8(__func__, frame_types);
+	wake_filter = frame_types;
+}
+
 void
 rx_usb_intr_handler(void)
 {
@@ -88,9 +348,12 @@ rx_usb_intr_handler(void)
 
 	if (flags & USBCSIL_SENT_STALL) {
 		USB.in_ep.csil = 0;
+		STATS_INC(usb_stalls);
 		LOGE("rx ep: stalled");
 	} else if (!flags) {
-		// Last pkt in usb fifo has been sent to host
-		enable_radio_pkt_ready_intr();
+		// Last pkt in usb fifo has been sent to host.
+		// Frames held back since boot go first.
+		if (!rx_early_deliver())
+			enable_radio_pkt_ready_intr();
 	}
 }
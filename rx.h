@@ -13,3 +13,36 @@ rx_usb_intr_handler(void);
 
 void
 rx_setup(void);
+
+// Peek at byte n of the first frame in rx fifo, without popping it.
+// Byte 0 is the phy header (frame length).
+u8
+rx_peek(u8 n);
+
+// Compare len bytes at p with rx fifo, starting at byte n
+__bit
+rx_peek_cmp(const __xdata u8 * p, u8 n, u8 len);
+
+// Returns FCF, if the first frame in rx fifo is a data request command, or 0
+u16
+rx_peek_data_request(void);
+
+// Pop the first frame from rx fifo
+void
+rx_drop(void);
+
+// Fast boot: Start receiving before host has configured us.
+// Frames are held back until rx_setup().
+void
+rx_early_start(void);
+
+__bit
+rx_early_active(void);
+
+// Call this when usb is resumed, to deliver a frame held back while suspended
+void
+rx_resume(void);
+
+// Bit mask of frame types, that wake up a suspended host. See usb_remote_wakeup_armed()
+void
+rx_set_wake_filter(u8 frame_types);
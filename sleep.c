@@ -10,6 +10,7 @@
 #include "led.h"
 #include "log.h"
 #include "radio.h"
+#include "trace.h"
 
 #include "sleep.h"
 
@@ -40,6 +41,8 @@ sleep_enter_pm1(void)
 
 	radio_stop();
 
+	trace(TRACE_SLEEP, 0);
+
 	watchdog_feed();
 
 	led_red_off();
@@ -57,6 +60,7 @@ sleep_enter_pm1(void)
 	} while (CLKCONSTA & CLK_OSC_16MHZ_RC);
 
 	LOGI("resuming now");
+	trace(TRACE_WAKE, 0);
 
 	// Now let's handle the interrupt that woke us up
 	interrupts_enable();
@@ -0,0 +1,85 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "bsp/usb.h"
+
+#include "config/misc.h"
+#include "int.h"
+#include "log.h"
+#include "mac_time.h"
+
+#include "sof_time.h"
+
+// Host can map MAC time to its own clock, by fitting offset and drift to
+// (frame number, MAC time) pairs, as it knows when it sent each SOF.
+//
+// The MAC timer is read as the first thing in the USB interrupt, so the
+// pairs are off by the (fairly constant) interrupt latency.
+
+static __xdata struct sof_time ring[CONFIG_SOF_TIME_COUNT];
+static __xdata struct sof_time_snapshot snapshot;
+
+static u8 next;
+static u8 count;
+
+void
+sof_time_enable(__bit enable)
+{
+	LOGDX8(__func__, enable);
+
+	__critical {
+		next = 0;
+		count = 0;
+
+		if (enable)
+			USB.cie |= USBCI_SOF;
+		else
+			USB.cie &= ~USBCI_SOF;
+	}
+}
+
+__bit
+sof_time_enabled(void)
+{
+	return (USB.cie & USBCI_SOF) != 0;
+}
+
+void
+sof_time_capture(void)
+{
+	u32 t = mac_time_now();
+
+	ring[next].frame = USB.frml | ((USB.frmh & 0x7) << 8);
+	ring[next].mac_time = t;
+
+	if (++next == CONFIG_SOF_TIME_COUNT)
+		next = 0;
+
+	if (count < CONFIG_SOF_TIME_COUNT)
+		count++;
+}
+
+const __xdata struct sof_time_snapshot *
+sof_time_snapshot(void)
+{
+	__critical {
+		u8 i = next;
+		u8 n = count;
+
+		snapshot.count = n;
+
+		__xdata struct sof_time * dst = snapshot.entries;
+		while (n--) {
+			if (i == 0)
+				i = CONFIG_SOF_TIME_COUNT;
+			i--;
+
+			dst->frame = ring[i].frame;
+			dst->mac_time = ring[i].mac_time;
+			dst++;
+		}
+	}
+
+	return &snapshot;
+}
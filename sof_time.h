@@ -0,0 +1,33 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "config/misc.h"
+#include "int.h"
+
+// MAC time captured at USB start of frame
+struct sof_time {
+	u16 frame;     // USB frame number (11 bits)
+	u32 mac_time;  // See mac_time.h
+};
+
+// Most recent captures, newest first
+struct sof_time_snapshot {
+	u8 count;      // Number of valid entries
+	u8 _reserved;
+	struct sof_time entries[CONFIG_SOF_TIME_COUNT];
+};
+
+void
+sof_time_enable(__bit enable);
+
+__bit
+sof_time_enabled(void);
+
+// Call this from USB interrupt on start of frame
+void
+sof_time_capture(void);
+
+const __xdata struct sof_time_snapshot *
+sof_time_snapshot(void);
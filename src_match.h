@@ -0,0 +1,22 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "bsp/bits.h"
+
+#include "int.h"
+
+// Source address matching table in radio RAM.
+// Either 24 short address entries of 4 bytes (PAN ID, short address),
+// or 12 extended address entries of 8 bytes, sharing the same memory.
+// Extended entry n overlaps short entry 2n, and both are controlled by bit 2n
+// in the enable and pending enable masks.
+#define SRC_MATCH_TABLE ((__xdata u8 *)0x6100)
+
+#define SRC_MATCH_SHORT_ENTRIES 24
+#define SRC_MATCH_EXT_ENTRIES   12
+
+// SRCRESINDEX: Set if the ACK to the last frame had frame pending set
+// by the radio, for a matching entry
+#define SRC_MATCH_RES_AUTOPEND BIT(6)
@@ -0,0 +1,34 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "int.h"
+#include "uart.h"
+
+#include "stats.h"
+
+// Counters are bumped in place from any context. Host reads a copy taken
+// with interrupts disabled, so it never sees a half updated counter.
+
+__xdata struct stats stats;
+
+static __xdata struct stats snapshot;
+
+const __xdata struct stats *
+stats_snapshot(void)
+{
+	__critical {
+		stats.version = STATS_VERSION;
+		stats.size = sizeof(stats);
+		stats.log_dropped = log_dropped;
+
+		const __xdata u8 * src = (const __xdata u8 *)&stats;
+		__xdata u8 * dst = (__xdata u8 *)&snapshot;
+		u8 n = sizeof(stats);
+		do {
+			*dst++ = *src++;
+		} while (--n);
+	}
+
+	return &snapshot;
+}
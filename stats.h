@@ -0,0 +1,41 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "int.h"
+
+#define STATS_VERSION 1
+
+// Counters wrap around. Host should look at differences between reads.
+struct stats {
+	u8 version;           // STATS_VERSION
+	u8 size;              // sizeof(struct stats)
+	u16 _reserved;
+
+	u32 rx_frames;        // Frames handed to usb
+	u32 rx_crc_errors;    // ... of which had bad CRC
+	u16 rx_overflows;
+	u16 rx_underflows;
+	u16 rx_aborts;
+	u16 rx_nlock;         // Synthesizer lost lock
+
+	u32 tx_success;
+	u16 tx_csma_failures;
+	u16 tx_errors;        // TX fifo overflow or underflow
+	u16 strobe_errors;
+
+	u16 usb_stalls;       // Sent on any endpoint
+	u16 usb_resets;
+	u16 usb_suspends;
+	u16 notify_dropped;   // Status events dropped, queue full
+	u16 log_dropped;      // Log bytes dropped, ring full
+};
+
+extern __xdata struct stats stats;
+
+#define STATS_INC(_field) (stats._field++)
+
+// Returns a consistent copy of all counters
+const __xdata struct stats *
+stats_snapshot(void);
@@ -0,0 +1,66 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hw.h"
+
+#include "check.h"
+
+static int failures;
+static int failed;
+static int tests;
+
+void
+check_failed(const char * file, int line, const char * expr, int values, long a, long b)
+{
+	fprintf(stderr, "%s:%d: check failed: %s", file, line, expr);
+	if (values)
+		fprintf(stderr, " (%ld != %ld)", a, b);
+	fprintf(stderr, "\n");
+	failures++;
+}
+
+void (* check_abort_hook)(void);
+
+void
+check_abort(const char * file, int line, const char * expr)
+{
+	fprintf(stderr, "%s:%d: assertion failed: %s\n", file, line, expr);
+	if (check_abort_hook)
+		check_abort_hook();
+	abort();
+}
+
+int
+check_memcmp(const void * a, const void * b, unsigned long n)
+{
+	return memcmp(a, b, n);
+}
+
+void
+check_run(const char * name, void (* test)(void))
+{
+	int before = failures;
+
+	hw_reset();
+	test();
+	tests++;
+
+	if (failures != before) {
+		failed++;
+		printf("FAIL %s\n", name);
+	} else {
+		printf("ok   %s\n", name);
+	}
+}
+
+int
+check_summary(void)
+{
+	printf("%d of %d tests passed\n", tests - failed, tests);
+	return failed != 0;
+}
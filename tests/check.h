@@ -0,0 +1,57 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+// Minimal test runner. Test files include firmware headers, which clash
+// with stdio (see log.h), so all reporting is done in check.c.
+
+#define CHECK(_cond)                                                           \
+	{                                                                          \
+		if (!(_cond))                                                          \
+			check_failed(__FILE__, __LINE__, #_cond, 0, 0, 0);                 \
+	}
+
+#define CHECK_EQ(_a, _b)                                                       \
+	{                                                                          \
+		long _va = (long)(_a);                                                 \
+		long _vb = (long)(_b);                                                 \
+		if (_va != _vb)                                                        \
+			check_failed(__FILE__, __LINE__, #_a " == " #_b, 1, _va, _vb);     \
+	}
+
+#define CHECK_MEM(_a, _b, _n)                                                  \
+	{                                                                          \
+		if (check_memcmp((_a), (_b), (_n)))                                    \
+			check_failed(__FILE__, __LINE__, #_a " == " #_b, 0, 0, 0);         \
+	}
+
+// Stops right away, for invariants checked while fuzzing
+#define ASSERT(_cond)                                                          \
+	{                                                                          \
+		if (!(_cond))                                                          \
+			check_abort(__FILE__, __LINE__, #_cond);                           \
+	}
+
+#define RUN(_test) check_run(#_test, _test)
+
+void
+check_failed(const char * file, int line, const char * expr, int values, long a, long b);
+
+void
+check_abort(const char * file, int line, const char * expr);
+
+// Called by check_abort(), before aborting
+extern void (* check_abort_hook)(void);
+
+int
+check_memcmp(const void * a, const void * b, unsigned long n);
+
+// Runs a test with freshly reset hardware
+void
+check_run(const char * name, void (* test)(void));
+
+// Exit status for main()
+int
+check_summary(void);
@@ -0,0 +1,16 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include <stddef.h>
+
+#include "int.h"
+
+// Run one input. Same entry point as libFuzzer uses.
+int
+LLVMFuzzerTestOneInput(const u8 * data, size_t size);
+
+// Make up an input of at most size bytes, for runs without libFuzzer
+size_t
+fuzz_generate(u8 * buf, size_t size, u32 (* rnd)(void));
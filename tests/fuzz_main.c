@@ -0,0 +1,104 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+// Runs a fuzzing harness without libFuzzer: Either with made up inputs,
+// or with the given input files, e.g. to reproduce a crash.
+//
+//   fuzz_usb_control_ep [-n runs] [-s seed]
+//   fuzz_usb_control_ep file...
+//
+// A failing input is written to crash.bin.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "check.h"
+
+#include "fuzz.h"
+
+#define MAX_INPUT_LEN 4096
+
+static u8 buf[MAX_INPUT_LEN];
+static size_t buf_len;
+static u32 rnd_state;
+
+static u32
+rnd(void)
+{
+	// xorshift32
+	u32 x = rnd_state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return rnd_state = x;
+}
+
+static void
+save_input(void)
+{
+	FILE * f = fopen("crash.bin", "wb");
+	if (f) {
+		fwrite(buf, 1, buf_len, f);
+		fclose(f);
+		fprintf(stderr, "input written to crash.bin\n");
+	}
+}
+
+static int
+run_file(const char * path)
+{
+	FILE * f = fopen(path, "rb");
+	if (!f) {
+		perror(path);
+		return 1;
+	}
+
+	buf_len = fread(buf, 1, sizeof(buf), f);
+	fclose(f);
+
+	LLVMFuzzerTestOneInput(buf, buf_len);
+	printf("ok   %s\n", path);
+	return 0;
+}
+
+int
+main(int argc, char ** argv)
+{
+	unsigned long runs = 10000;
+	unsigned long seed = 1;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+		switch (opt) {
+		case 'n':
+			runs = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n runs] [-s seed] [file...]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	check_abort_hook = save_input;
+
+	if (optind < argc) {
+		int err = 0;
+		for (int i = optind; i < argc; i++)
+			err |= run_file(argv[i]);
+		return err;
+	}
+
+	rnd_state = seed ? seed : 1;
+	for (unsigned long i = 0; i < runs; i++) {
+		buf_len = fuzz_generate(buf, sizeof(buf), rnd);
+		LLVMFuzzerTestOneInput(buf, buf_len);
+	}
+
+	printf("%lu runs with seed %lu passed\n", runs, seed);
+	return 0;
+}
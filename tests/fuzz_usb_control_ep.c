@@ -0,0 +1,518 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+// Fuzzing harness for the EP0 request handler and data stage state machine.
+// The real usb_control_ep.c is included, so its state can be checked, and
+// the real frame templates are linked in. Everything else it calls is
+// stubbed, with the same length limits as the real thing.
+//
+// Input is a sequence of control transfers:
+//   { u8 setup[8]; u8 ctrl; } ...
+// OUT data stages take their data from what follows, zero padded if the
+// input runs out.
+//
+// ctrl bit 7: Host abandons the transfer after (ctrl & 0xf) data packets,
+//             by sending another SETUP
+// ctrl bit 6: ... which arrives together with the SETUP_END it causes
+// ctrl bit 5: A frame for a device that has just polled us is being sent,
+//             so tx_prepare() refuses
+
+#include "usb_control_ep.c"
+
+#include "check.h"
+#include "hw.h"
+
+#include "fuzz.h"
+
+#define CTRL_ABORT      BIT(7)
+#define CTRL_ABORT_SETUP BIT(6)
+#define CTRL_INDIRECT_BUSY BIT(5)
+#define CTRL_ABORT_AFTER(_ctrl) ((_ctrl) & 0xf)
+
+// Stand-ins
+
+__xdata struct stats stats;
+__bit tx_busy;
+static u8 prepared_len;
+static __bit indirect_busy;
+
+// Refuses when the real one does. A frame being written over one that's
+// half written is caught by check_idle(), after the transfer.
+__bit
+tx_prepare(u8 msdu_len)
+{
+	ASSERT(msdu_len >= 1 && msdu_len <= TX_MAX_LEN);
+
+	if (tx_busy || indirect_busy)
+		return 1;
+
+	hw_queue_clear(&hw_txfifo);
+	prepared_len = msdu_len;
+	tx_busy = 1;
+	return 0;
+}
+
+static void
+tx_send(void)
+{
+	ASSERT(tx_busy);
+	ASSERT(hw_queue_len(&hw_txfifo) == prepared_len);
+	hw_queue_clear(&hw_txfifo);
+	tx_busy = 0;
+}
+
+void tx_now(void) { tx_send(); }
+void tx_csma(void) { tx_send(); }
+
+void
+tx_abort(void)
+{
+	hw_queue_clear(&hw_txfifo);
+	tx_busy = 0;
+}
+
+static __xdata struct {
+	struct tx_params params;
+	u8 frame[TX_MAX_LEN];
+} staged;
+
+u8 __xdata *
+tx_params_begin(u16 len)
+{
+	if (len <= sizeof(struct tx_params) || len > sizeof(struct tx_params) + TX_MAX_LEN)
+		return NULL;
+	return (u8 __xdata *)&staged;
+}
+
+void tx_params_send_now(void) {}
+void tx_params_send_csma(void) {}
+void tx_set_csma_params(u16 packed_params) { (void)packed_params; }
+void tx_setup(void) {}
+void tx_report_status(u8 status) { (void)status; }
+void tx_report_set_handle(u8 handle) { (void)handle; }
+void tx_report_enable(__bit enable) { (void)enable; }
+void latency_tx_request(void) {}
+void rx_setup(void) {}
+void rx_set_wake_filter(u8 frame_types) { (void)frame_types; }
+void notify_set_packed(__bit enable) { (void)enable; }
+void poll_responder_enable(__bit enable) { (void)enable; }
+void sof_time_enable(__bit enable) { (void)enable; }
+void boot_stage(u8 stage) { (void)stage; }
+void bootloader_enter(void) {}
+void dyn_usb_desc_init(void) {}
+
+static __bit remote_wakeup;
+void usb_set_remote_wakeup(__bit enable) { remote_wakeup = enable; }
+__bit usb_remote_wakeup_enabled(void) { return remote_wakeup; }
+
+static __xdata u8 indirect_frame[INDIRECT_MAX_LEN];
+
+u8 __xdata *
+indirect_enqueue_begin(u8 handle, u16 persistence_time, u16 len)
+{
+	(void)handle;
+	(void)persistence_time;
+
+	if (len < 5 || len > INDIRECT_MAX_LEN)
+		return NULL;
+	return indirect_frame;
+}
+
+void indirect_enqueue_done(void) {}
+__bit indirect_purge(u8 handle) { return handle & 1; }
+
+static __xdata u8 config[FLASH_CONFIG_MAX_LEN];
+
+u8 __xdata *
+flash_config_write_begin(u16 len)
+{
+	if (len > FLASH_CONFIG_MAX_LEN)
+		return NULL;
+	return config;
+}
+
+void flash_config_write_done(void) {}
+const __xdata u8 * flash_config_read(void) { return config; }
+
+__bit caps_set_features(u16 features) { return features >> 8; }
+
+static __xdata u16 poll_count;
+static __xdata struct sof_time_snapshot sof_time;
+static __xdata struct trace trace_buf;
+static __xdata struct latency latency;
+static __xdata struct stats stats_copy;
+static __xdata struct mem_usage mem;
+static __xdata struct caps caps;
+static __xdata struct boot_timeline timeline;
+
+const __xdata u16 * poll_responder_count(void) { return &poll_count; }
+const __xdata struct sof_time_snapshot * sof_time_snapshot(void) { return &sof_time; }
+const __xdata struct trace * trace_buffer(void) { return &trace_buf; }
+const __xdata struct latency * latency_snapshot(__bit reset) { (void)reset; return &latency; }
+const __xdata struct stats * stats_snapshot(void) { return &stats_copy; }
+const __xdata struct mem_usage * mem_usage(void) { return &mem; }
+const __xdata struct caps * caps_get(void) { return &caps; }
+const __xdata struct boot_timeline * boot_timeline(void) { return &timeline; }
+
+// Descriptors as bytes, as the real ones are laid out for a 16 bit int.
+// The configuration descriptor is two whole packets.
+static const __code u8 device_desc[18] = { 18, USB_DT_DEVICE, 0x00, 0x02, 0, 0, 0, CTRL_EP_MAXPKTSIZE };
+static const __code u8 config_desc[64] = { 9, USB_DT_CONFIGURATION, 64, 0, 1, 1, 0, 0x80, 25 };
+static const __code u8 langid_desc[4] = { 4, USB_DT_STRING, 0x09, 0x04 };
+static __xdata u8 serial_desc[10] = { 10, USB_DT_STRING, 'f', 0, 'u', 0, 'z', 0, 'z', 0 };
+
+const void __code *
+const_usb_desc_get(u16 wValue)
+{
+	switch (wValue) {
+	case USB_DT_DEVICE << 8:
+		return device_desc;
+	case USB_DT_CONFIGURATION << 8:
+		return config_desc;
+	case USB_DT_STRING << 8:
+		return langid_desc;
+	default:
+		return NULL;
+	}
+}
+
+const void __xdata *
+dyn_usb_desc_get(u16 wValue)
+{
+	return wValue == (USB_DT_STRING << 8 | 3) ? serial_desc : NULL;
+}
+
+// Host, and the EP0 part of the USB controller
+
+#define CS0 hw_usb_ep[CTRL_EP][1]
+
+static const u8 * input;
+static size_t input_left;
+
+// Armed by firmware
+static u8 in_pkt_len;
+static __bit data_end;
+static __bit send_stall;
+
+static void
+ep0_write(u8 ep, u8 reg, u8 val, u8 * bank)
+{
+	if (ep != CTRL_EP || reg != 1)
+		return;
+
+	// Status bits, as firmware sees them. Any write clears SENT_STALL.
+	u8 cs0 = CS0 & (USBCS0_OUTPKT_RDY | USBCS0_INPKT_RDY | USBCS0_SETUP_END);
+
+	if (val & USBCS0_CLR_OUTPKT_RDY) {
+		// Firmware read exactly what host sent, no more, no less
+		ASSERT(CS0 & USBCS0_OUTPKT_RDY);
+		ASSERT(hw_queue_len(&hw_usb_out[CTRL_EP]) == 0);
+		ASSERT(hw_usb_out[CTRL_EP].underruns == 0);
+		cs0 &= ~USBCS0_OUTPKT_RDY;
+	}
+
+	if (val & USBCS0_CLR_SETUP_END)
+		cs0 &= ~USBCS0_SETUP_END;
+
+	if (val & USBCS0_SEND_STALL)
+		send_stall = 1;
+
+	if (val & USBCS0_DATA_END)
+		data_end = 1;
+
+	if (val & USBCS0_INPKT_RDY) {
+		ASSERT(!(CS0 & USBCS0_INPKT_RDY));
+		in_pkt_len = hw_queue_len(&hw_usb_in[CTRL_EP]);
+		ASSERT(in_pkt_len <= CTRL_EP_MAXPKTSIZE);
+		cs0 |= USBCS0_INPKT_RDY;
+	}
+
+	bank[1] = cs0;
+}
+
+static void
+check_idle(void)
+{
+	ASSERT(state == STATE_IDLE);
+	ASSERT(!dma_is_armed(DMA_CH));
+	ASSERT(!tx_busy);
+	ASSERT(!(CS0 & (USBCS0_OUTPKT_RDY | USBCS0_INPKT_RDY | USBCS0_SETUP_END)));
+	ASSERT(hw_queue_len(&hw_usb_in[CTRL_EP]) == 0);
+	ASSERT(hw_usb_out[CTRL_EP].underruns == 0);
+}
+
+static u8
+next_byte(void)
+{
+	if (!input_left)
+		return 0;
+
+	input_left--;
+	return *input++;
+}
+
+// Host sends another SETUP in the middle of a transfer. The packet firmware
+// may have armed is flushed.
+static void
+setup_end(void)
+{
+	CS0 = (CS0 & ~USBCS0_INPKT_RDY) | USBCS0_SETUP_END;
+	hw_queue_clear(&hw_usb_in[CTRL_EP]);
+}
+
+static void
+stall_sent(void)
+{
+	send_stall = 0;
+	CS0 |= USBCS0_SENT_STALL;
+	usb_control_intr_handler();
+	ASSERT(state == STATE_IDLE);
+	CS0 &= ~USBCS0_SENT_STALL;
+}
+
+// Returns 1 if the transfer was abandoned
+static __bit
+in_stage(u16 len, u8 ctrl)
+{
+	u16 total = 0;
+	u8 pkts = 0;
+	__bit last;
+
+	do {
+		// Firmware must never leave host waiting
+		ASSERT(CS0 & USBCS0_INPKT_RDY);
+
+		if (ctrl & CTRL_ABORT && pkts == CTRL_ABORT_AFTER(ctrl))
+			return 1;
+
+		u8 n = in_pkt_len;
+		u8 pkt[CTRL_EP_MAXPKTSIZE];
+		ASSERT(hw_queue_read(&hw_usb_in[CTRL_EP], pkt, n) == n);
+		ASSERT(hw_queue_len(&hw_usb_in[CTRL_EP]) == 0);
+
+		total += n;
+		pkts++;
+		ASSERT(total <= len);
+
+		// A short packet, or all that was asked for, ends the data stage
+		last = n < CTRL_EP_MAXPKTSIZE || total == len;
+		ASSERT(data_end == last);
+
+		CS0 &= ~USBCS0_INPKT_RDY;
+		usb_control_intr_handler();
+	} while (!last);
+
+	return 0;
+}
+
+static __bit
+out_stage(u16 len, u8 ctrl)
+{
+	u8 pkts = 0;
+
+	do {
+		if (ctrl & CTRL_ABORT && pkts == CTRL_ABORT_AFTER(ctrl))
+			return 1;
+
+		u8 n = len < CTRL_EP_MAXPKTSIZE ? len : CTRL_EP_MAXPKTSIZE;
+		for (u8 i = 0; i < n; i++)
+			hw_queue_push(&hw_usb_out[CTRL_EP], next_byte());
+
+		CS0 |= USBCS0_OUTPKT_RDY;
+		usb_control_intr_handler();
+		ASSERT(!(CS0 & USBCS0_OUTPKT_RDY));
+
+		len -= n;
+		pkts++;
+
+		if (send_stall) {
+			stall_sent();
+			return 0;
+		}
+
+		// Data stage ends with the last packet, not before
+		ASSERT(data_end == !len);
+	} while (len);
+
+	return 0;
+}
+
+// Returns 1 if the transfer was abandoned
+static __bit
+transfer(void)
+{
+	u8 setup[8];
+	for (u8 i = 0; i < sizeof(setup); i++)
+		setup[i] = next_byte();
+	u8 ctrl = next_byte();
+
+	u8 rt = setup[0];
+	u16 len = setup[6] | (setup[7] << 8);
+
+	data_end = 0;
+	send_stall = 0;
+	indirect_busy = ctrl & CTRL_INDIRECT_BUSY;
+
+	hw_queue_write(&hw_usb_out[CTRL_EP], setup, sizeof(setup));
+	CS0 |= USBCS0_OUTPKT_RDY;
+	usb_control_intr_handler();
+
+	ASSERT(!(CS0 & (USBCS0_OUTPKT_RDY | USBCS0_SETUP_END)));
+
+	if (send_stall) {
+		ASSERT(!data_end);
+		stall_sent();
+		return 0;
+	}
+
+	// Nothing more to do, with or without a data stage
+	if (data_end && !(CS0 & USBCS0_INPKT_RDY))
+		return 0;
+
+	ASSERT(len);
+
+	__bit abandoned;
+	if (rt & USB_RT_DIR_IN)
+		abandoned = in_stage(len, ctrl);
+	else
+		abandoned = out_stage(len, ctrl);
+
+	if (!abandoned)
+		return 0;
+
+	setup_end();
+
+	// Otherwise SETUP_END comes with the next SETUP
+	if (!(ctrl & CTRL_ABORT_SETUP) || input_left < 9) {
+		usb_control_intr_handler();
+		return 0;
+	}
+
+	return 1;
+}
+
+int
+LLVMFuzzerTestOneInput(const u8 * data, size_t size)
+{
+	hw_reset();
+	hw_usb_ep_write = ep0_write;
+
+	usb_control_init();
+
+	// Firmware configures EP0 for 32 byte packets, and EP1-5 on
+	// SET_CONFIGURATION, which isn't modelled
+	for (u8 ep = 1; ep <= 5; ep++)
+		hw_usb_ep[ep][0] = hw_usb_ep[ep][3] = ep == 5 ? 8 : 2;
+
+	tx_busy = 0;
+	remote_wakeup = 0;
+
+	input = data;
+	input_left = size;
+
+	while (input_left >= 9) {
+		if (!transfer())
+			check_idle();
+	}
+
+	return 0;
+}
+
+// Mostly requests that are handled, with lengths around packet and buffer sizes
+
+#define REQUEST(_rt, _req) { USB_RT_##_rt, USB_REQ_##_req }
+
+static const u8 requests[][2] = {
+	REQUEST(VENDOR_DEV_OUT, VENDOR_XDATA_WRITE),
+	REQUEST(VENDOR_DEV_OUT, VENDOR_FIFO_WRITE),
+	REQUEST(VENDOR_DEV_OUT, VENDOR_TX),
+	REQUEST(VENDOR_DEV_OUT, VENDOR_TX),
+	REQUEST(VENDOR_DEV_OUT, VENDOR_TX),
+	REQUEST(VENDOR_DEV_OUT, VENDOR_SET_CSMA),
+	REQUEST(VENDOR_DEV_OUT, VENDOR_TX_TEMPLATE_SET),
+	REQUEST(VENDOR_DEV_OUT, VENDOR_TX_TEMPLATE),
+	REQUEST(VENDOR_DEV_OUT, VENDOR_TX_TEMPLATE),
+	REQUEST(VENDOR_DEV_OUT, VENDOR_INDIRECT_QUEUE),
+	REQUEST(VENDOR_DEV_OUT, VENDOR_INDIRECT_PURGE),
+	REQUEST(VENDOR_DEV_OUT, VENDOR_SET_POLL_RESPONDER),
+	REQUEST(VENDOR_DEV_OUT, VENDOR_TX_PARAMS),
+	REQUEST(VENDOR_DEV_OUT, VENDOR_SET_TX_REPORT),
+	REQUEST(VENDOR_DEV_OUT, VENDOR_SET_NOTIFY),
+	REQUEST(VENDOR_DEV_OUT, VENDOR_SET_WAKE_FILTER),
+	REQUEST(VENDOR_DEV_OUT, VENDOR_SET_SOF_TIME),
+	REQUEST(VENDOR_DEV_OUT, VENDOR_SET_FEATURES),
+	REQUEST(VENDOR_DEV_OUT, VENDOR_CONFIG_WRITE),
+	REQUEST(VENDOR_DEV_IN, VENDOR_XDATA_READ),
+	REQUEST(VENDOR_DEV_IN, VENDOR_FIFO_READ),
+	REQUEST(VENDOR_DEV_IN, VENDOR_GET_POLL_COUNT),
+	REQUEST(VENDOR_DEV_IN, VENDOR_GET_SOF_TIME),
+	REQUEST(VENDOR_DEV_IN, VENDOR_GET_PROFILE),
+	REQUEST(VENDOR_DEV_IN, VENDOR_GET_TRACE),
+	REQUEST(VENDOR_DEV_IN, VENDOR_GET_LATENCY),
+	REQUEST(VENDOR_DEV_IN, VENDOR_GET_STATS),
+	REQUEST(VENDOR_DEV_IN, VENDOR_GET_MEM_USAGE),
+	REQUEST(VENDOR_DEV_IN, VENDOR_GET_CAPS),
+	REQUEST(VENDOR_DEV_IN, VENDOR_CONFIG_READ),
+	REQUEST(VENDOR_DEV_IN, VENDOR_GET_BOOT_TIMELINE),
+	REQUEST(STD_DEV_OUT, SET_ADDRESS),
+	REQUEST(STD_DEV_OUT, SET_CONFIGURATION),
+	REQUEST(STD_DEV_OUT, SET_FEATURE),
+	REQUEST(STD_DEV_OUT, CLEAR_FEATURE),
+	REQUEST(STD_DEV_IN, GET_STATUS),
+	REQUEST(STD_DEV_IN, GET_DESCRIPTOR),
+	REQUEST(STD_DEV_IN, GET_DESCRIPTOR),
+	REQUEST(STD_DEV_IN, GET_CONFIGURATION),
+	REQUEST(STD_EP_OUT, SET_FEATURE),
+	REQUEST(STD_EP_OUT, CLEAR_FEATURE),
+	REQUEST(STD_EP_IN, GET_STATUS),
+	REQUEST(STD_INTF_OUT, SET_INTF),
+	REQUEST(STD_INTF_IN, GET_STATUS),
+	REQUEST(STD_INTF_IN, GET_INTF),
+	REQUEST(CLASS_INTF_OUT, DFU_DETACH),
+};
+
+static const u16 lengths[] = {
+	0, 1, 2, 3, 8, 9, 18, 31, 32, 33, 63, 64, 65, 96, 125, 126, 128, 129, 0x200,
+};
+
+#define PICK(_arr, _r) ((_arr)[(_r) % (sizeof(_arr) / sizeof((_arr)[0]))])
+
+size_t
+fuzz_generate(u8 * buf, size_t size, u32 (* rnd)(void))
+{
+	size_t n = 0;
+	u8 transfers = 1 + rnd() % 8;
+
+	while (transfers-- && n + 9 + 64 <= size) {
+		u8 rt = rnd();
+		u8 req = rnd();
+		if (rnd() % 8) {
+			const u8 * r = PICK(requests, rnd());
+			rt = r[0];
+			req = r[1];
+		}
+		u16 value = rnd() % 2 ? rnd() % 4 : rnd();
+		u16 index = rnd() % 2 ? rnd() % 6 : rnd();
+		u16 len = rnd() % 8 ? PICK(lengths, rnd()) : rnd();
+
+		// wValue of descriptor requests
+		if (req == USB_REQ_GET_DESCRIPTOR && rnd() % 2)
+			value = (1 + rnd() % 3) << 8 | rnd() % 4;
+
+		buf[n++] = rt;
+		buf[n++] = req;
+		buf[n++] = value;
+		buf[n++] = value >> 8;
+		buf[n++] = index;
+		buf[n++] = index >> 8;
+		buf[n++] = len;
+		buf[n++] = len >> 8;
+		buf[n++] = rnd() % 3 ? 0 : rnd();
+
+		for (u8 i = rnd() % 64; i; i--)
+			buf[n++] = rnd();
+	}
+
+	return n;
+}
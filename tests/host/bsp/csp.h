@@ -0,0 +1,37 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#define CSP_CMD_START   0x01
+#define CSP_CMD_STOP    0x02
+#define CSP_CMD_RXON    0x03
+#define CSP_CMD_TXON    0x09
+#define CSP_CMD_TXONCCA 0x0a
+#define CSP_CMD_FLUSHRX 0x0d
+#define CSP_CMD_FLUSHTX 0x0e
+#define CSP_CMD_RFOFF   0x0f
+#define CSP_CMD_CLEAR   0x1f
+
+#define CSP_IMM_CMD_STROBE(_cmd) (0xe0 | (_cmd))
+
+// Program instructions, encoded as in tools/cspsim.py
+#define CSP_IF_CCA     0
+#define CSP_IF_SFD     1
+#define CSP_IF_X_0     4
+#define CSP_IF_Y_0     5
+#define CSP_IF_Z_0     6
+#define CSP_IF_NOT_CCA (0x08 | CSP_IF_CCA)
+#define CSP_IF_Z_NOT_0 (0x08 | CSP_IF_Z_0)
+
+#define CSP_INSN_SKIP(_cond, _n) (((_n) << 4) | (_cond))
+#define CSP_INSN_RPT(_cond)      (0xa0 | (_cond))
+#define CSP_INSN_INT             0xba
+#define CSP_INSN_LABEL           0xbb
+#define CSP_INSN_WAITX           0xbc
+#define CSP_INSN_RANDXY          0xbd
+#define CSP_INSN_INCZ            0xc2
+#define CSP_INSN_DECZ            0xc5
+#define CSP_INSN_INCMAXY(_m)     (0xc8 | ((_m) & 7))
+#define CSP_INSN_STROBE(_cmd)    (0xd0 | (_cmd))
@@ -0,0 +1,61 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "hw_regs.h"
+
+// Channel configuration, loaded when armed. Transfers are done one
+// trigger at a time by hw.c, through the same pointers firmware gave.
+struct dma_conf {
+	const volatile void * src;
+	volatile void * dst;
+	u16 len;
+	u8 mode1;
+	u8 mode2;
+};
+
+#define TRIG_NONE  0
+#define TRIG_FLASH 18
+
+#define BYTEMODE 0
+#define ONESHOT  0
+#define WORD8    0
+
+#define PRIORITY_HIGH 2
+#define NO_MASK8      0
+#define INTR_DISABLE  0
+#define SRC_CONST     0
+#define DST_CONST     0
+
+#define DMA_MODE2_SRCMODE_SHIFT 6
+#define DMA_MODE2_DSTMODE_SHIFT 4
+
+#define DMA_MODE2(_prio, _m8, _irq, _dst, _src)                               \
+	(((_src) << DMA_MODE2_SRCMODE_SHIFT) | ((_dst) << DMA_MODE2_DSTMODE_SHIFT) \
+	 | ((_irq) << 3) | ((_m8) << 2) | (_prio))
+
+#define dma_set_src(_conf, _p)  { (_conf).src = (_p); }
+#define dma_set_dst(_conf, _p)  { (_conf).dst = (_p); }
+#define dma_set_len(_conf, _n)  { (_conf).len = (_n); }
+#define dma_set_mode1(_conf, _trig, _tmode, _mode, _wsize) { (_conf).mode1 = (_trig); }
+
+#define DMAARM (hw->sfr.dmaarm)
+
+void
+hw_dma_init(u8 ch, struct dma_conf * conf);
+
+void
+hw_dma_arm(u8 ch);
+
+_Bool
+hw_dma_is_armed(u8 ch);
+
+void
+hw_dma_trig(u8 ch);
+
+#define dma_init_ch0(_conf)    hw_dma_init(0, (_conf))
+#define dma_init_ch1234(_conf) hw_dma_init(1, (_conf))
+#define dma_arm(_ch)           hw_dma_arm(_ch)
+#define dma_is_armed(_ch)      hw_dma_is_armed(_ch)
+#define dma_trig(_ch)          hw_dma_trig(_ch)
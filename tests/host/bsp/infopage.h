@@ -0,0 +1,15 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "hw_regs.h"
+
+struct infopage {
+	struct hw_ext_addr ieee_addr;
+};
+
+// Plain memory, tests fill it in
+extern struct infopage hw_infopage;
+
+#define INFOPAGE hw_infopage
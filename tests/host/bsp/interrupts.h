@@ -0,0 +1,18 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "hw_regs.h"
+
+// Interrupt handlers are plain functions on the host, called by tests
+#define INTERRUPT(_name, _vect) void _name(void)
+
+#define interrupts_enable()
+#define interrupts_disable()
+
+#define IEN2         (hw->sfr.ien2)
+#define IEN0_RFERRIE (hw->sfr.ien0_rferrie)
+#define TCON_RFERRIF (hw->sfr.tcon_rferrif)
+
+#define IEN2_RFIE    0x01
@@ -0,0 +1,44 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "hw_regs.h"
+
+#define T2CTRL  (hw->sfr.t2ctrl)
+#define T2MSEL  (hw->sfr.t2msel)
+#define T2M0    (hw->sfr.t2m0)
+#define T2M1    (hw->sfr.t2m1)
+#define T2MOVF0 (hw->sfr.t2movf0)
+#define T2MOVF1 (hw->sfr.t2movf1)
+#define T2MOVF2 (hw->sfr.t2movf2)
+
+#define T2CTRL_RUN        0x01
+#define T2CTRL_LATCH_MODE 0x08
+
+// T2M0/T2M1 register selection
+enum {
+	T2M_TIMER   = 0,
+	T2M_CAPTURE = 1,
+	T2M_PERIOD  = 2,
+	T2M_CMP1    = 3,
+	T2M_CMP2    = 4,
+};
+
+// T2MOVF0-2 register selection
+enum {
+	T2OVF_OVERFLOW = 0,
+	T2OVF_CAPTURE  = 1,
+	T2OVF_PERIOD   = 2,
+	T2OVF_CMP1     = 3,
+	T2OVF_CMP2     = 4,
+};
+
+#define mac_timer_select_multiplexed_regs(_m, _ovf) { T2MSEL = ((_ovf) << 4) | (_m); }
+
+#define mac_timer_set_period(_period)                                          \
+	{                                                                          \
+		mac_timer_select_multiplexed_regs(T2M_PERIOD, T2OVF_OVERFLOW);         \
+		T2M0 = (u8)(_period);                                                  \
+		T2M1 = (u8)((_period) >> 8);                                           \
+	}
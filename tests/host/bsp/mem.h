@@ -0,0 +1,9 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+// One address space on the host
+#define mmap_code_to_xdata(_p)  ((const void *)(_p))
+#define mmap_idata_to_xdata(_p) ((void *)(_p))
@@ -0,0 +1,17 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+// Observation outputs go nowhere on the host
+
+#define RFC_OBS_SIG0 0
+#define RFC_OBS_SIG1 1
+#define RFC_OBS_SIG2 2
+
+#define RFC_OBS_MUX_TX_ACTIVE       0x09
+#define RFC_OBS_MUX_RFC_SNIFF_DATA  0x30
+#define RFC_OBS_MUX_RFC_SNIFF_CLK   0x31
+
+#define obs_enable(_pin, _sig) {}
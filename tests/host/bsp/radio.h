@@ -0,0 +1,42 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "hw_regs.h"
+
+// Reading pops the rx fifo, writing pushes to the tx fifo. See hw.h
+#define RFD     (hw->sfr.rfd)
+#define RFST    (hw->sfr.rfst)
+#define RFIRQF0 (hw->sfr.rfirqf0)
+#define RFIRQF1 (hw->sfr.rfirqf1)
+#define RFERRF  (hw->sfr.rferrf)
+#define S1CON   (hw->sfr.s1con)
+
+// RFD as mapped in XDATA, for DMA
+#define X_RFD   RFD
+
+#define RADIO   (hw->radio)
+
+#define RFIRQF0_SFD             0x02
+#define RFIRQF0_FIFOP           0x04
+#define RFIRQF0_SRC_MATCH_DONE  0x08
+#define RFIRQF0_SRC_MATCH_FOUND 0x10
+#define RFIRQF0_FRAME_ACCEPTED  0x20
+#define RFIRQF0_RXPKTDONE       0x40
+#define RFIRQF0_RXMASKZERO      0x80
+
+#define RFIRQF1_TXACKDONE       0x01
+#define RFIRQF1_TXDONE          0x02
+#define RFIRQF1_RFIDLE          0x04
+#define RFIRQF1_CSP_MANINT      0x08
+#define RFIRQF1_CSP_STOP        0x10
+#define RFIRQF1_CSP_WAIT        0x20
+
+#define RFERRF_NLOCK            0x01
+#define RFERRF_RXABO            0x02
+#define RFERRF_RXOVERF          0x04
+#define RFERRF_RXUNDERF         0x08
+#define RFERRF_TXOVERF          0x10
+#define RFERRF_TXUNDERF         0x20
+#define RFERRF_STROBEERR        0x40
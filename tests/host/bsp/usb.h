@@ -0,0 +1,44 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "bits.h"
+#include "hw_regs.h"
+
+#define USB (hw->usb)
+
+#define usb_select_endpoint(_ep) { USB.index = (_ep); }
+
+#define USB_EP0_FIFO_SIZE 32
+
+
+#define USBCS0_OUTPKT_RDY     BIT(0)
+#define USBCS0_INPKT_RDY      BIT(1)
+#define USBCS0_SENT_STALL     BIT(2)
+#define USBCS0_DATA_END       BIT(3)
+#define USBCS0_SETUP_END      BIT(4)
+#define USBCS0_SEND_STALL     BIT(5)
+#define USBCS0_CLR_OUTPKT_RDY BIT(6)
+#define USBCS0_CLR_SETUP_END  BIT(7)
+
+#define USBCSIL_INPKT_RDY     BIT(0)
+#define USBCSIL_PKT_PRESENT   BIT(1)
+#define USBCSIL_UNDERRUN      BIT(2)
+#define USBCSIL_FLUSH_PACKET  BIT(3)
+#define USBCSIL_SEND_STALL    BIT(4)
+#define USBCSIL_SENT_STALL    BIT(5)
+#define USBCSIL_CLR_DATA_TOG  BIT(6)
+
+#define USBCSIH_IN_DBL_BUF    BIT(0)
+#define USBCSIH_ENABLE        BIT(5)
+#define USBCSIH_AUTOSET       BIT(7)
+
+#define USBCSOL_OUTPKT_RDY    BIT(0)
+#define USBCSOL_FIFO_FULL     BIT(1)
+#define USBCSOL_OVERRUN       BIT(2)
+#define USBCSOL_DATA_ERROR    BIT(3)
+#define USBCSOL_FLUSH_PACKET  BIT(4)
+#define USBCSOL_SEND_STALL    BIT(5)
+#define USBCSOL_SENT_STALL    BIT(6)
+#define USBCSOL_CLR_DATA_TOG  BIT(7)
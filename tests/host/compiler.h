@@ -0,0 +1,7 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+// Stands in for SDCC's compiler.h. See sdcc.h.
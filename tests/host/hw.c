@@ -0,0 +1,455 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "hw_regs.h"
+#include "bsp/dma.h"
+#include "bsp/infopage.h"
+
+#include "hw.h"
+
+// All registers live in one page that is normally inaccessible. An access
+// faults (SIGSEGV), and the page is made accessible for exactly one
+// instruction, by returning to it with the trap flag set. The trap after
+// it (SIGTRAP) locks the page again.
+//
+// Side effects of reads are applied before the instruction (a fifo read
+// pops a byte into the register), and side effects of writes after it (a
+// fifo write pushes the byte written).
+//
+// x86-64 Linux only, which is all the host build needs.
+
+#define EFLAGS_TF 0x100
+#define PF_WRITE  0x2
+
+volatile struct hw_regs * hw;
+
+struct hw_queue hw_txfifo;
+struct hw_queue hw_rxfifo;
+struct hw_queue hw_rfst;
+struct hw_queue hw_usb_in[6];
+struct hw_queue hw_usb_out[6];
+u8 hw_usb_ep[6][8];
+void (* hw_usb_ep_write)(u8 ep, u8 reg, u8 val, u8 * bank);
+u16 hw_t2m[8];
+u32 hw_t2movf[8];
+u8 hw_xdata[0x10000];
+u8 * hw_rxfifo_ram = &hw_xdata[0x6000];
+struct infopage hw_infopage;
+
+static long page_size;
+
+// Register being accessed by the instruction that is single stepped
+static size_t access_offset;
+static _Bool access_write;
+// Value before a write, for registers where writing 1 leaves a bit as is
+static u8 access_old;
+
+#define REG(_field) offsetof(struct hw_regs, _field)
+#define USB_REG(_off) (REG(usb) + (_off))
+
+#define USB_INDEXED_FIRST USB_REG(0x10)
+#define USB_INDEXED_LAST  USB_REG(0x17)
+#define USB_FIFO_FIRST    USB_REG(0x20)
+#define USB_FIFO_LAST     USB_REG(0x2a)
+
+// Firmware's view of the registers, without traps. Only used from handlers.
+static u8 *
+regs(void)
+{
+	return (u8 *)hw;
+}
+
+void
+hw_queue_clear(struct hw_queue * q)
+{
+	q->head = q->tail = 0;
+	q->underruns = q->overruns = 0;
+}
+
+u16
+hw_queue_len(const struct hw_queue * q)
+{
+	return q->tail - q->head;
+}
+
+void
+hw_queue_push(struct hw_queue * q, u8 b)
+{
+	if (q->tail == HW_QUEUE_LEN) {
+		q->overruns++;
+		return;
+	}
+
+	q->data[q->tail++] = b;
+}
+
+u8
+hw_queue_pop(struct hw_queue * q)
+{
+	if (q->head == q->tail) {
+		q->underruns++;
+		return 0;
+	}
+
+	u8 b = q->data[q->head++];
+	if (q->head == q->tail)
+		q->head = q->tail = 0;
+	return b;
+}
+
+u16
+hw_queue_read(struct hw_queue * q, u8 * dst, u16 n)
+{
+	u16 i;
+	for (i = 0; i < n && q->head != q->tail; i++)
+		dst[i] = hw_queue_pop(q);
+	return i;
+}
+
+void
+hw_queue_write(struct hw_queue * q, const u8 * src, u16 n)
+{
+	while (n--)
+		hw_queue_push(q, *src++);
+}
+
+static void
+load_usb_bank(void)
+{
+	u8 ep = regs()[USB_REG(0x0e)] & 7;
+	if (ep < 6)
+		memcpy(regs() + USB_INDEXED_FIRST, hw_usb_ep[ep], 8);
+}
+
+static void
+store_usb_bank(size_t offset)
+{
+	u8 ep = regs()[USB_REG(0x0e)] & 7;
+	if (ep >= 6)
+		return;
+
+	u8 reg = offset - USB_INDEXED_FIRST;
+	u8 val = regs()[offset];
+
+	if (hw_usb_ep_write)
+		hw_usb_ep_write(ep, reg, val, hw_usb_ep[ep]);
+	else
+		hw_usb_ep[ep][reg] = val;
+
+	memcpy(regs() + USB_INDEXED_FIRST, hw_usb_ep[ep], 8);
+}
+
+static void
+latch_t2m(void)
+{
+	u8 sel = regs()[REG(sfr.t2msel)];
+	u16 m = hw_t2m[sel & 7];
+	u32 ovf = hw_t2movf[(sel >> 4) & 7];
+
+	regs()[REG(sfr.t2m0)] = m;
+	regs()[REG(sfr.t2m1)] = m >> 8;
+	regs()[REG(sfr.t2movf0)] = ovf;
+	regs()[REG(sfr.t2movf1)] = ovf >> 8;
+	regs()[REG(sfr.t2movf2)] = ovf >> 16;
+}
+
+static void
+store_t2m(size_t offset)
+{
+	u8 sel = regs()[REG(sfr.t2msel)];
+	u16 * m = &hw_t2m[sel & 7];
+	u32 * ovf = &hw_t2movf[(sel >> 4) & 7];
+	u8 val = regs()[offset];
+
+	if (offset == REG(sfr.t2m0))
+		*m = (*m & 0xff00) | val;
+	else if (offset == REG(sfr.t2m1))
+		*m = (*m & 0x00ff) | (val << 8);
+	else if (offset == REG(sfr.t2movf0))
+		*ovf = (*ovf & 0xffff00) | val;
+	else if (offset == REG(sfr.t2movf1))
+		*ovf = (*ovf & 0xff00ff) | ((u32)val << 8);
+	else
+		*ovf = (*ovf & 0x00ffff) | ((u32)val << 16);
+}
+
+// Radio
+
+static volatile struct hw_radio *
+radio(void)
+{
+	return &((volatile struct hw_regs *)regs())->radio;
+}
+
+// With FIFOP_THR at its max, FIFOP is set while the frame at the head of
+// the rx fifo has been completely received
+static void
+update_fsmstat1(void)
+{
+	u16 len = hw_queue_len(&hw_rxfifo);
+
+	radio()->fsmstat1.fifo = len != 0;
+	radio()->fsmstat1.fifop = len && len > (hw_rxfifo.data[hw_rxfifo.head] & 0x7f);
+}
+
+static u8
+pop_rxfifo(void)
+{
+	radio()->rxfirst_ptr = (radio()->rxfirst_ptr + 1) & 0x7f;
+	return hw_queue_pop(&hw_rxfifo);
+}
+
+static void
+flush_rxfifo(void)
+{
+	hw_queue_clear(&hw_rxfifo);
+	radio()->rxfirst_ptr = 0;
+}
+
+void
+hw_rx_frame(const u8 * psdu, u8 len)
+{
+	mprotect((void *)hw, page_size, PROT_READ | PROT_WRITE);
+	u8 ptr = radio()->rxfirst_ptr + hw_queue_len(&hw_rxfifo);
+	mprotect((void *)hw, page_size, PROT_NONE);
+
+	hw_rxfifo_ram[ptr++ & 0x7f] = len;
+	hw_queue_push(&hw_rxfifo, len);
+
+	for (u8 i = 0; i < len; i++) {
+		hw_rxfifo_ram[ptr++ & 0x7f] = psdu[i];
+		hw_queue_push(&hw_rxfifo, psdu[i]);
+	}
+}
+
+void
+hw_flags_set(volatile u8 * reg, u8 flags)
+{
+	mprotect((void *)hw, page_size, PROT_READ | PROT_WRITE);
+	*reg |= flags;
+	mprotect((void *)hw, page_size, PROT_NONE);
+}
+
+static void dma_abort(u8 channels);
+
+// Before the instruction
+static void
+access_begin(size_t offset, _Bool write)
+{
+	if (offset >= USB_INDEXED_FIRST && offset <= USB_INDEXED_LAST) {
+		load_usb_bank();
+		return;
+	}
+
+	if (write) {
+		access_old = regs()[offset];
+		return;
+	}
+
+	if (offset == REG(sfr.rfd))
+		regs()[offset] = pop_rxfifo();
+	else if (offset == REG(radio.fsmstat1))
+		update_fsmstat1();
+	else if (offset == REG(sfr.t2m0))
+		latch_t2m();
+	else if (offset >= USB_FIFO_FIRST && offset <= USB_FIFO_LAST && !((offset - USB_FIFO_FIRST) & 1))
+		regs()[offset] = hw_queue_pop(&hw_usb_out[(offset - USB_FIFO_FIRST) / 2]);
+}
+
+// After the instruction
+static void
+access_end(size_t offset)
+{
+	u8 val = regs()[offset];
+
+	if (offset == REG(sfr.rfd)) {
+		hw_queue_push(&hw_txfifo, val);
+	} else if (offset == REG(sfr.rfst)) {
+		hw_queue_push(&hw_rfst, val);
+		if (val == 0xee)
+			hw_queue_clear(&hw_txfifo);
+		else if (val == 0xed)
+			flush_rxfifo();
+	} else if (offset == REG(sfr.rfirqf0) || offset == REG(sfr.rfirqf1) || offset == REG(sfr.rferrf)) {
+		// Interrupt flags are cleared by writing 0, and nothing sets them
+		regs()[offset] = access_old & val;
+	} else if (offset == REG(sfr.dmaarm)) {
+		if (val & 0x80)
+			dma_abort(val & 0x1f);
+	} else if (offset >= REG(sfr.t2m0) && offset <= REG(sfr.t2movf2)) {
+		store_t2m(offset);
+	} else if (offset == USB_REG(0x0e)) {
+		load_usb_bank();
+	} else if (offset >= USB_INDEXED_FIRST && offset <= USB_INDEXED_LAST) {
+		store_usb_bank(offset);
+	} else if (offset >= USB_FIFO_FIRST && offset <= USB_FIFO_LAST && !((offset - USB_FIFO_FIRST) & 1)) {
+		hw_queue_push(&hw_usb_in[(offset - USB_FIFO_FIRST) / 2], val);
+	}
+}
+
+static void
+segv_handler(int sig, siginfo_t * info, void * ctx)
+{
+	ucontext_t * uc = ctx;
+	u8 * addr = info->si_addr;
+
+	(void)sig;
+
+	if (addr < regs() || addr >= regs() + page_size) {
+		// A real crash
+		signal(SIGSEGV, SIG_DFL);
+		return;
+	}
+
+	mprotect((void *)hw, page_size, PROT_READ | PROT_WRITE);
+
+	access_offset = addr - regs();
+	access_write = uc->uc_mcontext.gregs[REG_ERR] & PF_WRITE;
+	access_begin(access_offset, access_write);
+
+	uc->uc_mcontext.gregs[REG_EFL] |= EFLAGS_TF;
+}
+
+static void
+trap_handler(int sig, siginfo_t * info, void * ctx)
+{
+	ucontext_t * uc = ctx;
+
+	(void)sig;
+	(void)info;
+
+	uc->uc_mcontext.gregs[REG_EFL] &= ~EFLAGS_TF;
+
+	if (access_write)
+		access_end(access_offset);
+
+	mprotect((void *)hw, page_size, PROT_NONE);
+}
+
+// DMA
+
+#define DMA_CHANNELS 5
+
+static struct {
+	struct dma_conf * conf;
+	const volatile void * src;
+	volatile void * dst;
+	u16 src_offset;
+	u16 dst_offset;
+	u16 len;
+	_Bool armed;
+} dma[DMA_CHANNELS];
+
+// XDATA addresses given as integers are mapped to hw_xdata, and wrap around
+// at 64 KiB, just like on the chip
+static volatile u8 *
+dma_addr(const volatile void * base, u16 offset)
+{
+	if ((size_t)base < sizeof(hw_xdata))
+		return &hw_xdata[(u16)((size_t)base + offset)];
+	return (volatile u8 *)base + offset;
+}
+
+static void
+dma_abort(u8 channels)
+{
+	for (u8 ch = 0; ch < DMA_CHANNELS; ch++)
+		if (channels & (1 << ch))
+			dma[ch].armed = 0;
+}
+
+void
+hw_dma_init(u8 ch, struct dma_conf * conf)
+{
+	dma[ch].conf = conf;
+	dma[ch].armed = 0;
+}
+
+void
+hw_dma_arm(u8 ch)
+{
+	struct dma_conf * conf = dma[ch].conf;
+
+	dma[ch].src = conf->src;
+	dma[ch].dst = conf->dst;
+	dma[ch].src_offset = 0;
+	dma[ch].dst_offset = 0;
+	dma[ch].len = conf->len;
+	dma[ch].armed = conf->len != 0;
+}
+
+_Bool
+hw_dma_is_armed(u8 ch)
+{
+	return dma[ch].armed;
+}
+
+void
+hw_dma_trig(u8 ch)
+{
+	if (!dma[ch].armed)
+		return;
+
+	u8 mode2 = dma[ch].conf->mode2;
+
+	*dma_addr(dma[ch].dst, dma[ch].dst_offset) = *dma_addr(dma[ch].src, dma[ch].src_offset);
+	if ((mode2 >> DMA_MODE2_SRCMODE_SHIFT) & 3)
+		dma[ch].src_offset++;
+	if ((mode2 >> DMA_MODE2_DSTMODE_SHIFT) & 3)
+		dma[ch].dst_offset++;
+
+	if (!--dma[ch].len)
+		dma[ch].armed = 0;
+}
+
+void
+hw_reset(void)
+{
+	mprotect((void *)hw, page_size, PROT_READ | PROT_WRITE);
+	memset(regs(), 0, page_size);
+	mprotect((void *)hw, page_size, PROT_NONE);
+
+	hw_queue_clear(&hw_txfifo);
+	hw_queue_clear(&hw_rxfifo);
+	hw_queue_clear(&hw_rfst);
+	for (int i = 0; i < 6; i++) {
+		hw_queue_clear(&hw_usb_in[i]);
+		hw_queue_clear(&hw_usb_out[i]);
+	}
+
+	memset(&hw_infopage, 0, sizeof(hw_infopage));
+	memset(hw_usb_ep, 0, sizeof(hw_usb_ep));
+	hw_usb_ep_write = NULL;
+	memset(hw_t2m, 0, sizeof(hw_t2m));
+	memset(hw_t2movf, 0, sizeof(hw_t2movf));
+	memset(dma, 0, sizeof(dma));
+}
+
+__attribute__((constructor)) static void
+hw_init(void)
+{
+	struct sigaction sa;
+
+	page_size = sysconf(_SC_PAGESIZE);
+	hw = mmap(NULL, page_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_flags = SA_SIGINFO;
+
+	sa.sa_sigaction = segv_handler;
+	sigaction(SIGSEGV, &sa, NULL);
+
+	sa.sa_sigaction = trap_handler;
+	sigaction(SIGTRAP, &sa, NULL);
+
+	hw_reset();
+}
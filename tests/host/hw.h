@@ -0,0 +1,86 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "int.h"
+
+// Mocked peripherals, for firmware code built and run on the host.
+//
+// Firmware accesses registers just like on the chip, through the mock bsp
+// headers. Registers with side effects (fifos, strobes, latches, indexed
+// USB endpoint registers) are modelled here, and tests look at, or feed,
+// the queues behind them.
+
+#define HW_QUEUE_LEN 512
+
+struct hw_queue {
+	u8 data[HW_QUEUE_LEN];
+	u16 head;
+	u16 tail;
+	// Reads from an empty queue, and writes to a full one
+	u16 underruns;
+	u16 overruns;
+};
+
+// Written to RFD (tx fifo), and read from RFD (rx fifo)
+extern struct hw_queue hw_txfifo;
+extern struct hw_queue hw_rxfifo;
+
+// Radio RAM that the rx fifo is mapped to. It's at a fixed address in
+// XDATA on the chip, so tests point this at the firmware's rx fifo buffer.
+extern u8 * hw_rxfifo_ram;
+
+// Every byte written to RFST
+extern struct hw_queue hw_rfst;
+
+// USB endpoint fifos: IN is written by firmware, OUT is read by firmware
+extern struct hw_queue hw_usb_in[6];
+extern struct hw_queue hw_usb_out[6];
+
+// Banked USB endpoint registers, as selected by USBINDEX
+extern u8 hw_usb_ep[6][8];
+
+// Called when firmware writes an indexed USB register, with the value
+// written, instead of storing it in the bank. For registers where writes
+// are commands, not values.
+extern void (* hw_usb_ep_write)(u8 ep, u8 reg, u8 val, u8 * bank);
+
+// MAC timer: T2M0-1, and T2MOVF0-2, as selected by T2MSEL
+extern u16 hw_t2m[8];
+extern u32 hw_t2movf[8];
+
+// Fake XDATA, for DMA to and from addresses that are integers on the chip
+extern u8 hw_xdata[0x10000];
+
+void
+hw_reset(void);
+
+// A frame received by the radio: pushes the phy header (len), and the len
+// bytes of psdu, as they are in the rx fifo, ending with RSSI and CRC_OK.
+void
+hw_rx_frame(const u8 * psdu, u8 len);
+
+// Peripheral raises interrupt flags, in a register where firmware can only
+// clear them, such as RFIRQF0
+void
+hw_flags_set(volatile u8 * reg, u8 flags);
+
+void
+hw_queue_clear(struct hw_queue * q);
+
+u16
+hw_queue_len(const struct hw_queue * q);
+
+void
+hw_queue_push(struct hw_queue * q, u8 b);
+
+u8
+hw_queue_pop(struct hw_queue * q);
+
+// Pop n bytes into dst, and return the number popped
+u16
+hw_queue_read(struct hw_queue * q, u8 * dst, u16 n);
+
+void
+hw_queue_write(struct hw_queue * q, const u8 * src, u16 n);
@@ -0,0 +1,166 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "int.h"
+
+// Registers of the mocked peripherals, as seen by firmware through the
+// mock bsp headers. They all live in one page that firmware can't normally
+// access, so every access traps into hw.c, where fifo, strobe and latch
+// registers get the side effects they have on the real chip.
+
+// SFRs, and XDATA mapped radio registers the mock knows about
+struct hw_sfr {
+	u8 rfd;
+	u8 rfst;
+	u8 rfirqf0;
+	u8 rfirqf1;
+	u8 s1con;
+	u8 dmaarm;
+	u8 t2ctrl;
+	u8 t2msel;
+	u8 t2m0;
+	u8 t2m1;
+	u8 t2movf0;
+	u8 t2movf1;
+	u8 t2movf2;
+	u8 rferrf;
+	u8 ien2;
+	// Bit addressable SFR bits, a byte each
+	u8 ien0_rferrie;
+	u8 tcon_rferrif;
+};
+
+// XDATA mapped radio registers, just the fields firmware uses. Bit fields
+// are at the same bit positions as on the chip.
+struct hw_ext_addr {
+	u8 addr[8];
+};
+
+struct hw_radio {
+	u8 rfirqm0;
+	u8 rfirqm1;
+	u8 rferrm;
+	u8 fifop_thr;
+	u8 rxfirst_ptr;
+	u8 txfirst_ptr;
+	u8 freqctrl;
+	u8 txpower;
+	s8 cca_thr;
+	u8 agcctrl1_agc_ref;
+	u8 txfiltcfg_fc;
+	u8 fscal1_vco_curr;
+	u8 srcresindex;
+	u8 srcresmask[3];
+	u8 srcshorten[3];
+	u8 srcshortpenden[3];
+	u8 srcexten[3];
+	u8 srcextpenden[3];
+	u8 rfc_obs_ctrl[3];
+	struct hw_ext_addr ext_add;
+	struct {
+		u8 x;
+		u8 y;
+		u8 z;
+	} csp;
+	struct {
+		u8 _reserved : 1;
+		u8 autoack : 1;
+		u8 _reserved1 : 6;
+	} frmctrl0;
+	struct {
+		u8 src_match_en : 1;
+		u8 _reserved : 7;
+	} srcmatch;
+	struct {
+		u8 rx2rx_time_off : 1;
+		u8 _reserved : 7;
+	} fsmctrl;
+	struct {
+		u8 fsm_ffctrl_state : 6;
+		u8 _reserved : 2;
+	} fsmstat0;
+	// Updated from the rx fifo whenever read. See hw.c
+	struct {
+		u8 _reserved : 6;
+		u8 fifop : 1;
+		u8 fifo : 1;
+	} fsmstat1;
+	struct {
+		u8 rssi_valid : 1;
+		u8 _reserved : 7;
+	} rssistat;
+	struct {
+		u8 _reserved : 3;
+		u8 cca_mode : 2;
+		u8 _reserved1 : 3;
+	} ccactrl1;
+	struct {
+		u8 rfc_sniff_en : 1;
+		u8 _reserved : 7;
+	} mdmtest1;
+};
+
+// Indexed endpoint registers (USBMAXI to USBCNTH), selected by USBINDEX
+struct usb_ep_regs {
+	u8 maxi;
+	u8 csil;
+	u8 csih;
+	u8 maxo;
+	u8 csol;
+	u8 csoh;
+	u8 cntl;
+	u8 cnth;
+};
+
+// Same registers, as named for endpoint 0
+struct usb_ctrl_ep_regs {
+	u8 _maxi;
+	u8 cs0;
+	u8 _csih;
+	u8 _maxo;
+	u8 _csol;
+	u8 _csoh;
+	u8 cnt0;
+	u8 _cnth;
+};
+
+struct usb_fifo_reg {
+	u8 fifo;
+	u8 _reserved;
+};
+
+struct usb_regs {
+	u8 addr;
+	u8 pow;
+	u8 iif;
+	u8 _reserved0;
+	u8 oif;
+	u8 _reserved1;
+	u8 cif;
+	u8 iie;
+	u8 _reserved2;
+	u8 oie;
+	u8 _reserved3;
+	u8 cie;
+	u8 frml;
+	u8 frmh;
+	u8 index;
+	u8 ctrl;
+	union {
+		struct usb_ep_regs in_ep;
+		struct usb_ep_regs out_ep;
+		struct usb_ctrl_ep_regs ctrl_ep;
+	};
+	u8 _reserved_zeroes[8];
+	struct usb_fifo_reg fifo[6];
+};
+
+struct hw_regs {
+	struct hw_sfr sfr;
+	struct usb_regs usb;
+	struct hw_radio radio;
+};
+
+extern volatile struct hw_regs * hw;
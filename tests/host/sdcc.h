@@ -0,0 +1,36 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+// Included first in every host build translation unit. SDCC's 8051 extensions
+// are mapped to plain C, just like compile_flags.txt does for clangd.
+// Memory spaces don't exist on the host, so every pointer is generic.
+
+#define __code
+#define __data
+#define __idata
+#define __pdata
+#define __xdata
+#define __at(_addr)
+#define __critical
+#define __reentrant
+#define __naked
+#define __bit _Bool
+#define __sfr static volatile unsigned char __attribute__((unused))
+#define __sbit static volatile unsigned char __attribute__((unused))
+
+// SDCC pragmas, such as callee_saves in log.h
+#pragma GCC diagnostic ignored "-Wunknown-pragmas"
+
+// C99 inline in a header, without an external definition anywhere
+#define inline static inline
+
+#define GIT_VERSION_STR "0.0"
+#define GIT_VERSION_USTR u"0.0"
+#define GIT_VERSION_MAJOR 0
+#define GIT_VERSION_MINOR 0
+
+// No uart on the host
+#define LOG_LEVEL 0
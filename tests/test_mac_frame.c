@@ -0,0 +1,108 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "mac_frame.h"
+
+#include "check.h"
+#include "hw.h"
+
+#define NONE  MAC_ADDR_MODE_NONE
+#define SHORT MAC_ADDR_MODE_SHORT
+#define EXT   MAC_ADDR_MODE_EXT
+
+// No source PAN ID, without a source address
+#define NA 0xff
+
+static const struct {
+	u8 dst_mode;
+	u8 src_mode;
+	u8 compressed;
+	u8 src_pan_offset;
+	u8 src_offset;
+	u8 hdr_len;
+} cases[] = {
+	{ NONE,  NONE,  0, NA,  3,  3 },
+	{ NONE,  SHORT, 0,  3,  5,  7 },
+	{ NONE,  EXT,   0,  3,  5, 13 },
+	{ SHORT, NONE,  0, NA,  7,  7 },
+	{ SHORT, SHORT, 0,  7,  9, 11 },
+	{ SHORT, EXT,   0,  7,  9, 17 },
+	{ EXT,   NONE,  0, NA, 13, 13 },
+	{ EXT,   SHORT, 0, 13, 15, 17 },
+	{ EXT,   EXT,   0, 13, 15, 23 },
+
+	// Source PAN ID left out, and same as destination PAN ID
+	{ NONE,  NONE,  1, NA,  3,  3 },
+	{ NONE,  SHORT, 1,  3,  3,  5 },
+	{ NONE,  EXT,   1,  3,  3, 11 },
+	{ SHORT, NONE,  1, NA,  7,  7 },
+	{ SHORT, SHORT, 1,  3,  7,  9 },
+	{ SHORT, EXT,   1,  3,  7, 15 },
+	{ EXT,   NONE,  1, NA, 13, 13 },
+	{ EXT,   SHORT, 1,  3, 13, 15 },
+	{ EXT,   EXT,   1,  3, 13, 21 },
+};
+
+static u16
+fcf(u8 type, u8 dst_mode, u8 src_mode, u8 compressed)
+{
+	return type | (compressed ? MAC_FCF_PANID_COMPRESSION : 0) | (dst_mode << 10) | (src_mode << 14);
+}
+
+static void
+test_addr_modes(void)
+{
+	for (u8 i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		u16 f = fcf(MAC_FRAME_TYPE_DATA, cases[i].dst_mode, cases[i].src_mode, cases[i].compressed);
+
+		if (cases[i].src_pan_offset != NA)
+			CHECK_EQ(mac_src_pan_offset(f), cases[i].src_pan_offset);
+		CHECK_EQ(mac_src_offset(f), cases[i].src_offset);
+		CHECK_EQ(mac_hdr_len(f), cases[i].hdr_len);
+	}
+}
+
+// Other FCF bits don't matter
+static void
+test_other_bits(void)
+{
+	u16 f = fcf(MAC_FRAME_TYPE_CMD, SHORT, EXT, 1)
+		| MAC_FCF_SECURITY | MAC_FCF_FRAME_PENDING | MAC_FCF_ACK_REQUEST
+		| BIT(12) | BIT(13);
+
+	CHECK_EQ(mac_src_pan_offset(f), 3);
+	CHECK_EQ(mac_src_offset(f), 7);
+	CHECK_EQ(mac_hdr_len(f), 15);
+}
+
+static void
+test_frames(void)
+{
+	// Data frame, short addresses, PAN ID compression
+	static const u8 data[] = { 0x41, 0x88, 0x17, 0x34, 0x12, 0xff, 0xff, 0x01, 0x00, 0xaa };
+	u16 f = data[0] | (data[1] << 8);
+	CHECK_EQ(MAC_FCF_TYPE(f), MAC_FRAME_TYPE_DATA);
+	CHECK_EQ(mac_src_offset(f), 7);
+	CHECK_EQ(mac_hdr_len(f), 9);
+	CHECK_EQ(data[mac_hdr_len(f)], 0xaa);
+
+	// Beacon, short source address and PAN ID, no destination
+	static const u8 beacon[] = { 0x00, 0x80, 0x42, 0x34, 0x12, 0x00, 0x00, 0xff, 0xcf };
+	f = beacon[0] | (beacon[1] << 8);
+	CHECK_EQ(mac_src_pan_offset(f), 3);
+	CHECK_EQ(beacon[mac_src_pan_offset(f)], 0x34);
+	CHECK_EQ(mac_src_offset(f), 5);
+	CHECK_EQ(mac_hdr_len(f), 7);
+	CHECK_EQ(beacon[mac_hdr_len(f)], 0xff);
+}
+
+int
+main(void)
+{
+	RUN(test_addr_modes);
+	RUN(test_other_bits);
+	RUN(test_frames);
+
+	return check_summary();
+}
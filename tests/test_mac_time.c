@@ -0,0 +1,63 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "bsp/mac_timer.h"
+
+#include "mac_time.h"
+
+#include "check.h"
+#include "hw.h"
+
+#define T(_ovf, _cnt) (((u32)(_ovf) << 16) | (_cnt))
+
+static void
+test_setup(void)
+{
+	hw_t2m[T2M_TIMER] = 0x1111;
+	hw_t2movf[T2OVF_OVERFLOW] = 0x222222;
+
+	mac_time_setup();
+
+	CHECK_EQ(T2CTRL, T2CTRL_RUN | T2CTRL_LATCH_MODE);
+	CHECK_EQ(hw_t2m[T2M_PERIOD], MAC_TIMER_PERIOD);
+	CHECK_EQ(hw_t2movf[T2OVF_PERIOD], 0xffffff);
+	CHECK_EQ(hw_t2movf[T2OVF_CMP1], 100);
+	CHECK_EQ(hw_t2m[T2M_TIMER], 0);
+	CHECK_EQ(hw_t2movf[T2OVF_OVERFLOW], 0);
+}
+
+static void
+test_now(void)
+{
+	hw_t2m[T2M_TIMER] = 0x1234;
+	hw_t2movf[T2OVF_OVERFLOW] = 0x9a5678;
+	hw_t2m[T2M_CAPTURE] = 0x4321;
+	hw_t2movf[T2OVF_CAPTURE] = 0x8765;
+
+	// Only 16 bits of overflow count are kept
+	CHECK_EQ(mac_time_now(), 0x56781234);
+	CHECK_EQ(mac_time_ovf(), 0x5678);
+	CHECK_EQ(mac_time_sfd(), 0x87654321);
+}
+
+static void
+test_diff(void)
+{
+	CHECK_EQ(mac_time_diff(T(7, 300), T(7, 100)), 200);
+	CHECK_EQ(mac_time_diff(T(8, 100), T(7, 300)), MAC_TIMER_PERIOD - 200);
+	CHECK_EQ(mac_time_diff(T(10, 0), T(7, 0)), 3 * MAC_TIMER_PERIOD);
+
+	// Overflow count wraps
+	CHECK_EQ(mac_time_diff(T(1, 5), T(0xffff, 10)), 2 * MAC_TIMER_PERIOD - 5);
+}
+
+int
+main(void)
+{
+	RUN(test_setup);
+	RUN(test_now);
+	RUN(test_diff);
+
+	return check_summary();
+}
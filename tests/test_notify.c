@@ -0,0 +1,207 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "config/misc.h"
+#include "notify.h"
+#include "stats.h"
+#include "usb_config.h"
+
+#include "check.h"
+#include "hw.h"
+
+__xdata struct stats stats;
+
+// Packets armed on the status endpoint, in order
+static struct {
+	u8 data[INT_EP_MAXPKTSIZE];
+	u8 len;
+} pkts[64];
+static u8 pkt_count;
+
+static void
+int_ep_write(u8 ep, u8 reg, u8 val, u8 * bank)
+{
+	bank[reg] = val;
+
+	if (ep != INT_EP || reg != 1 || !(val & USBCSIL_INPKT_RDY))
+		return;
+
+	u8 n = hw_queue_len(&hw_usb_in[INT_EP]);
+	CHECK(n > 0 && n <= INT_EP_MAXPKTSIZE);
+	if (n > INT_EP_MAXPKTSIZE)
+		n = INT_EP_MAXPKTSIZE;
+
+	pkts[pkt_count].len = hw_queue_read(&hw_usb_in[INT_EP], pkts[pkt_count].data, n);
+	pkt_count++;
+}
+
+// Host is busy, with both packet buffers full
+static void
+host_busy(void)
+{
+	hw_usb_ep[INT_EP][1] = USBCSIL_INPKT_RDY;
+}
+
+// Host collects what was armed, and firmware gets the endpoint interrupt
+static void
+host_collect(void)
+{
+	hw_usb_ep[INT_EP][1] = 0;
+	notify_usb_intr_handler();
+}
+
+static void
+setup(__bit packed)
+{
+	hw_usb_ep_write = int_ep_write;
+	pkt_count = 0;
+	notify_reset();
+	notify_set_packed(packed);
+}
+
+static void
+post(u8 type, u8 len, u8 fill)
+{
+	static __xdata u8 payload[8];
+	for (u8 i = 0; i < len; i++)
+		payload[i] = fill + i;
+	notify_post(type, payload, len);
+}
+
+static void
+test_unpacked(void)
+{
+	setup(0);
+
+	post(NOTIFY_STATUS, 1, 0x42);
+	CHECK_EQ(pkt_count, 1);
+	CHECK_EQ(pkts[0].len, 1);
+	CHECK_EQ(pkts[0].data[0], 0x42);
+
+	// Endpoint still busy with the first one
+	post(NOTIFY_INDIRECT_STATUS, 2, 0x10);
+	CHECK_EQ(pkt_count, 1);
+
+	host_collect();
+	CHECK_EQ(pkt_count, 2);
+	CHECK_EQ(pkts[1].len, 2);
+	CHECK_EQ(pkts[1].data[0], 0x10);
+	CHECK_EQ(pkts[1].data[1], 0x11);
+
+	// Nothing left
+	host_collect();
+	CHECK_EQ(pkt_count, 2);
+}
+
+static void
+test_packed(void)
+{
+	setup(1);
+	host_busy();
+
+	post(NOTIFY_STATUS, 1, 0xa0);
+	post(NOTIFY_INDIRECT_STATUS, 2, 0xb0);
+	post(NOTIFY_STATUS, 1, 0xc0);
+	CHECK_EQ(pkt_count, 0);
+
+	host_collect();
+	CHECK_EQ(pkt_count, 1);
+	CHECK_EQ(pkts[0].len, 3 + 4 + 3);
+
+	u8 seq = pkts[0].data[1];
+	const u8 expected[] = {
+		0x11, seq, 0xa0,
+		0x22, (u8)(seq + 1), 0xb0, 0xb1,
+		0x11, (u8)(seq + 2), 0xc0,
+	};
+	CHECK_MEM(pkts[0].data, expected, sizeof(expected));
+}
+
+static void
+test_packed_split(void)
+{
+	setup(1);
+	host_busy();
+
+	// 6 events of 4 bytes, 4 fit in a packet
+	for (u8 i = 0; i < 6; i++)
+		post(NOTIFY_INDIRECT_STATUS, 2, i << 4);
+
+	host_collect();
+	host_collect();
+	host_collect();
+
+	CHECK_EQ(pkt_count, 2);
+	CHECK_EQ(pkts[0].len, 16);
+	CHECK_EQ(pkts[1].len, 8);
+	CHECK_EQ(pkts[1].data[2], 0x40);
+	CHECK_EQ(pkts[1].data[6], 0x50);
+}
+
+static void
+test_full(void)
+{
+	setup(1);
+	host_busy();
+
+	u16 dropped = stats.notify_dropped;
+
+	// 3 bytes each, and one byte of the ring is always unused
+	u8 fit = (CONFIG_NOTIFY_RING_LEN - 1) / 3;
+	for (u8 i = 0; i < fit + 1; i++)
+		post(NOTIFY_STATUS, 1, i);
+
+	CHECK_EQ(stats.notify_dropped, dropped + 1);
+
+	u8 n;
+	do {
+		n = pkt_count;
+		host_collect();
+	} while (pkt_count != n);
+
+	post(NOTIFY_STATUS, 1, 0xff);
+	host_collect();
+
+	// Everything but the dropped one, with a gap in sequence numbers
+	u8 events = 0;
+	u8 first_seq = pkts[0].data[1];
+	u8 last_seq = 0, last_payload = 0;
+	for (u8 i = 0; i < pkt_count; i++) {
+		for (u8 j = 0; j < pkts[i].len; j += 3) {
+			last_seq = pkts[i].data[j + 1];
+			last_payload = pkts[i].data[j + 2];
+			events++;
+		}
+	}
+
+	CHECK_EQ(events, fit + 1);
+	CHECK_EQ(last_payload, 0xff);
+	CHECK_EQ((u8)(last_seq - first_seq), fit + 1);
+}
+
+static void
+test_reset(void)
+{
+	setup(0);
+	host_busy();
+
+	post(NOTIFY_STATUS, 1, 1);
+	post(NOTIFY_STATUS, 1, 2);
+	notify_reset();
+
+	host_collect();
+	CHECK_EQ(pkt_count, 0);
+}
+
+int
+main(void)
+{
+	RUN(test_unpacked);
+	RUN(test_packed);
+	RUN(test_packed_split);
+	RUN(test_full);
+	RUN(test_reset);
+
+	return check_summary();
+}
@@ -0,0 +1,232 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+// Data requests go through the mocked rx fifo and the real rx path, and
+// are either absorbed, or delivered to the usb rx endpoint. The real rx.c
+// and poll_responder.c are included, as the rx fifo buffer is static.
+
+#include <string.h>
+
+#include "hw.h"
+
+#include "rx.c"
+
+// Radio RAM is at a fixed XDATA address on the chip
+#include "src_match.h"
+#undef SRC_MATCH_TABLE
+#define SRC_MATCH_TABLE (&hw_xdata[0x6100])
+
+#include "poll_responder.c"
+
+#include "check.h"
+
+__xdata struct stats stats;
+
+void indirect_rx_pkt_done(void) {}
+void tx_report_rx_frame(void) {}
+__bit usb_remote_wakeup_armed(void) { return 0; }
+void usb_remote_wakeup_request(void) {}
+
+static u8 pkt_count;
+
+static void
+rx_ep_write(u8 ep, u8 reg, u8 val, u8 * bank)
+{
+	if (ep != RXPKT_EP || reg != 1) {
+		bank[reg] = val;
+		return;
+	}
+
+	if (!(val & USBCSIL_INPKT_RDY))
+		return;
+
+	hw_queue_clear(&hw_usb_in[RXPKT_EP]);
+	pkt_count++;
+}
+
+static const u8 ext_addr[8] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08 };
+
+// Data Request, the way end devices send them: short destination (the
+// coordinator), extended source, PAN ID compression, as in the rx fifo
+static const u8 data_request[] = {
+	0x63, 0xc8,                 // Command, ack request, PAN ID compression
+	0x42,                       // DSN
+	0x34, 0x12,                 // Destination PAN ID
+	0x00, 0x00,                 // Destination address
+	0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+	MAC_CMD_DATA_REQUEST,
+	0xd0, 0x80 | 0x6b,          // RSSI, CRC_OK and correlation
+};
+
+// Short source, with its own PAN ID
+static const u8 data_request_short[] = {
+	0x23, 0x88,                 // Command, ack request
+	0x43,
+	0xff, 0xff,                 // Broadcast PAN ID
+	0x00, 0x00,
+	0x78, 0x56,                 // Source PAN ID
+	0xcd, 0xab,                 // Source address
+	MAC_CMD_DATA_REQUEST,
+	0xd0, 0x80 | 0x6b,
+};
+
+static void
+rx(const u8 * psdu, u8 len)
+{
+	hw_rx_frame(psdu, len);
+	rx_radio_intr_handler(RFIRQF0_FIFOP);
+}
+
+static void
+set_ext_entry(u8 entry, const u8 * addr, __bit pending)
+{
+	memcpy(SRC_MATCH_TABLE + entry * 8, addr, 8);
+
+	u8 bit = entry * 2;
+	RADIO.srcexten[bit >> 3] |= BIT(bit & 7);
+	if (pending)
+		RADIO.srcextpenden[bit >> 3] |= BIT(bit & 7);
+}
+
+static void
+set_short_entry(u8 entry, u16 pan, u16 addr, __bit pending)
+{
+	__xdata u8 * e = SRC_MATCH_TABLE + entry * 4;
+	e[0] = pan;
+	e[1] = pan >> 8;
+	e[2] = addr;
+	e[3] = addr >> 8;
+
+	RADIO.srcshorten[entry >> 3] |= BIT(entry & 7);
+	if (pending)
+		RADIO.srcshortpenden[entry >> 3] |= BIT(entry & 7);
+}
+
+static void
+setup(void)
+{
+	hw_rxfifo_ram = rxfifo;
+	hw_usb_ep_write = rx_ep_write;
+	pkt_count = 0;
+	polls_absorbed = 0;
+	memset(&hw_xdata[0x6100], 0, 96);
+
+	rx_setup();
+	poll_responder_enable(1);
+}
+
+static void
+test_parse(void)
+{
+	setup();
+
+	hw_rx_frame(data_request, sizeof(data_request));
+	CHECK_EQ(rx_peek_data_request(), 0xc863);
+	CHECK_EQ(mac_hdr_len(0xc863), 15);
+	CHECK_EQ(1 + mac_src_pan_offset(0xc863), 4);
+	CHECK_EQ(1 + mac_src_offset(0xc863), 8);
+	CHECK(rx_peek_cmp(ext_addr, 1 + mac_src_offset(0xc863), 8));
+	rx_drop();
+
+	hw_rx_frame(data_request_short, sizeof(data_request_short));
+	CHECK_EQ(rx_peek_data_request(), 0x8823);
+	CHECK_EQ(rx_peek(1 + mac_src_pan_offset(0x8823)), 0x78);
+	CHECK_EQ(rx_peek(1 + mac_src_offset(0x8823)), 0xcd);
+}
+
+static void
+test_nothing_pending(void)
+{
+	setup();
+
+	// Another device has something pending, or would have
+	static const u8 other[8] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x09 };
+	set_ext_entry(0, other, 1);
+	set_ext_entry(5, ext_addr, 0);
+
+	rx(data_request, sizeof(data_request));
+
+	CHECK_EQ(pkt_count, 0);
+	CHECK_EQ(*poll_responder_count(), 1);
+	CHECK_EQ(hw_queue_len(&hw_rxfifo), 0);
+}
+
+static void
+test_pending(void)
+{
+	setup();
+
+	set_ext_entry(5, ext_addr, 1);
+	rx(data_request, sizeof(data_request));
+
+	CHECK_EQ(pkt_count, 1);
+	CHECK_EQ(*poll_responder_count(), 0);
+	CHECK_EQ(hw_queue_len(&hw_rxfifo), 0);
+}
+
+// Source PAN ID is the one in the frame, not the destination PAN ID
+static void
+test_short_pending(void)
+{
+	setup();
+
+	set_short_entry(3, 0xffff, 0xabcd, 1);
+	rx(data_request_short, sizeof(data_request_short));
+	CHECK_EQ(pkt_count, 0);
+
+	set_short_entry(7, 0x5678, 0xabcd, 1);
+	rx(data_request_short, sizeof(data_request_short));
+	CHECK_EQ(pkt_count, 1);
+	CHECK_EQ(*poll_responder_count(), 1);
+}
+
+static void
+test_not_data_request(void)
+{
+	setup();
+
+	u8 psdu[sizeof(data_request)];
+
+	// Association request
+	memcpy(psdu, data_request, sizeof(psdu));
+	psdu[15] = 0x01;
+	rx(psdu, sizeof(psdu));
+	CHECK_EQ(pkt_count, 1);
+
+	// No ack request, so no frame pending either
+	memcpy(psdu, data_request, sizeof(psdu));
+	psdu[0] &= ~MAC_FCF_ACK_REQUEST;
+	rx(psdu, sizeof(psdu));
+	CHECK_EQ(pkt_count, 2);
+
+	// Too short for its header
+	rx(data_request, 14);
+	CHECK_EQ(pkt_count, 3);
+
+	CHECK_EQ(*poll_responder_count(), 0);
+}
+
+static void
+test_disabled(void)
+{
+	setup();
+
+	poll_responder_enable(0);
+	rx(data_request, sizeof(data_request));
+	CHECK_EQ(pkt_count, 1);
+	CHECK_EQ(*poll_responder_count(), 0);
+}
+
+int
+main(void)
+{
+	RUN(test_parse);
+	RUN(test_nothing_pending);
+	RUN(test_pending);
+	RUN(test_short_pending);
+	RUN(test_not_data_request);
+	RUN(test_disabled);
+
+	return check_summary();
+}
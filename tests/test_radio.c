@@ -0,0 +1,293 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+// Radio interrupts, from the flags raised by the mocked radio, through the
+// rf and rferr isrs, to the real rx and tx handlers. Everything the rx and
+// tx modules call in other modules is stubbed, apart from the ones that
+// only record things.
+
+#include <string.h>
+
+#include "bsp/csp.h"
+#include "bsp/infopage.h"
+#include "bsp/interrupts.h"
+#include "bsp/radio.h"
+#include "bsp/usb.h"
+
+#include "radio.h"
+#include "rx.h"
+#include "stats.h"
+#include "tx.h"
+#include "usb_config.h"
+
+#include "check.h"
+#include "hw.h"
+
+__xdata struct stats stats;
+
+static u8 reports;
+static u8 report_status;
+
+__bit
+poll_responder_absorb(void)
+{
+	return 0;
+}
+
+void
+indirect_rx_pkt_done(void)
+{
+}
+
+void
+indirect_ack_sent(void)
+{
+}
+
+__bit
+indirect_tx_busy(void)
+{
+	return 0;
+}
+
+void
+tx_report_rx_frame(void)
+{
+}
+
+void
+tx_report_start(void)
+{
+}
+
+void
+tx_report_done(u8 status, u8 attempts)
+{
+	(void)attempts;
+	reports++;
+	report_status = status;
+}
+
+void
+tx_report_status(u8 status)
+{
+	reports++;
+	report_status = status;
+}
+
+__bit
+usb_remote_wakeup_armed(void)
+{
+	return 0;
+}
+
+void
+usb_remote_wakeup_request(void)
+{
+}
+
+// Frames armed on the rx endpoint
+static u8 pkt_count;
+static u8 pkt_len;
+
+static void
+rx_ep_write(u8 ep, u8 reg, u8 val, u8 * bank)
+{
+	if (ep != RXPKT_EP || reg != 1) {
+		bank[reg] = val;
+		return;
+	}
+
+	if (!(val & USBCSIL_INPKT_RDY))
+		return;
+
+	pkt_len = hw_queue_len(&hw_usb_in[RXPKT_EP]);
+	hw_queue_clear(&hw_usb_in[RXPKT_EP]);
+	pkt_count++;
+
+	// Until host has collected it
+	bank[reg] = USBCSIL_INPKT_RDY;
+}
+
+static const u8 frame[] = {
+	0x41, 0x88, 0x17, 0x34, 0x12, 0xff, 0xff, 0x01, 0x00,
+	0xd0, 0x80 | 0x6b,  // RSSI, CRC_OK and correlation
+};
+
+static void
+setup(void)
+{
+	hw_usb_ep_write = rx_ep_write;
+	pkt_count = 0;
+	reports = 0;
+	memset(&stats, 0, sizeof(stats));
+
+	radio_setup();
+	rx_setup();
+	tx_setup();
+	hw_queue_clear(&hw_rfst);
+}
+
+static void
+test_setup(void)
+{
+	hw_infopage.ieee_addr.addr[0] = 0x12;
+	hw_infopage.ieee_addr.addr[7] = 0x34;
+
+	setup();
+
+	CHECK(RADIO.frmctrl0.autoack);
+	CHECK_EQ(RADIO.ext_add.addr[0], 0x12);
+	CHECK_EQ(RADIO.ext_add.addr[7], 0x34);
+	CHECK_EQ(RADIO.rferrm, 0x7f);
+	CHECK(IEN2 & IEN2_RFIE);
+	CHECK(IEN0_RFERRIE);
+}
+
+static void
+test_rx(void)
+{
+	setup();
+
+	hw_rx_frame(frame, sizeof(frame));
+	hw_flags_set(&RFIRQF0, RFIRQF0_FRAME_ACCEPTED | RFIRQF0_FIFOP);
+	rf_isr();
+
+	CHECK_EQ(pkt_count, 1);
+	CHECK_EQ(pkt_len, sizeof(frame));
+	CHECK_EQ(stats.rx_frames, 1);
+	CHECK_EQ(RFIRQF0, 0);
+	CHECK_EQ(hw_queue_len(&hw_rxfifo), 0);
+}
+
+// Flags not handled are left pending, also the ones masked, until firmware
+// unmasks them
+static void
+test_rx_masked(void)
+{
+	setup();
+
+	hw_rx_frame(frame, sizeof(frame));
+	hw_flags_set(&RFIRQF0, RFIRQF0_FIFOP);
+	rf_isr();
+	CHECK_EQ(pkt_count, 1);
+
+	// Usb is busy, so FIFOP is masked
+	hw_rx_frame(frame, sizeof(frame));
+	hw_flags_set(&RFIRQF0, RFIRQF0_SFD | RFIRQF0_FIFOP | RFIRQF0_RXPKTDONE);
+	rf_isr();
+	CHECK_EQ(pkt_count, 1);
+	CHECK_EQ(RFIRQF0, RFIRQF0_SFD | RFIRQF0_FIFOP);
+
+	// Host collects the first frame, and the second one follows
+	hw_usb_ep[RXPKT_EP][1] = 0;
+	rx_usb_intr_handler();
+	CHECK_EQ(pkt_count, 2);
+	CHECK_EQ(RFIRQF0, RFIRQF0_SFD);
+	CHECK_EQ(hw_queue_len(&hw_rxfifo), 0);
+}
+
+static void
+test_tx_done(void)
+{
+	setup();
+
+	CHECK_EQ(tx_prepare(sizeof(frame) - 2), 0);
+	tx_now();
+	CHECK(tx_busy);
+
+	hw_flags_set(&RFIRQF1, RFIRQF1_TXDONE);
+	rf_isr();
+
+	CHECK(!tx_busy);
+	CHECK_EQ(reports, 1);
+	CHECK_EQ(report_status, IEEE802154_SUCCESS);
+	CHECK_EQ(stats.tx_success, 1);
+	CHECK_EQ(RFIRQF1, 0);
+}
+
+static void
+test_csma_fail(void)
+{
+	setup();
+
+	CHECK_EQ(tx_prepare(sizeof(frame) - 2), 0);
+	tx_csma();
+
+	hw_flags_set(&RFIRQF1, RFIRQF1_CSP_MANINT);
+	rf_isr();
+
+	CHECK(!tx_busy);
+	CHECK_EQ(report_status, IEEE802154_CHANNEL_ACCESS_FAILURE);
+	CHECK_EQ(stats.tx_csma_failures, 1);
+}
+
+// Transmit completes, and a frame is received, before the isr runs
+static void
+test_tx_and_rx(void)
+{
+	setup();
+
+	CHECK_EQ(tx_prepare(sizeof(frame) - 2), 0);
+	tx_now();
+
+	hw_rx_frame(frame, sizeof(frame));
+	hw_flags_set(&RFIRQF1, RFIRQF1_TXDONE);
+	hw_flags_set(&RFIRQF0, RFIRQF0_FIFOP);
+	rf_isr();
+
+	CHECK_EQ(reports, 1);
+	CHECK_EQ(pkt_count, 1);
+	CHECK_EQ(RFIRQF0, 0);
+	CHECK_EQ(RFIRQF1, 0);
+}
+
+static void
+test_rx_overflow(void)
+{
+	setup();
+
+	hw_rx_frame(frame, sizeof(frame));
+	hw_flags_set(&RFERRF, RFERRF_RXOVERF);
+	rferr_isr();
+
+	CHECK_EQ(hw_queue_pop(&hw_rfst), CSP_IMM_CMD_STROBE(CSP_CMD_FLUSHRX));
+	CHECK_EQ(hw_queue_pop(&hw_rfst), CSP_IMM_CMD_STROBE(CSP_CMD_RXON));
+	CHECK_EQ(hw_queue_len(&hw_rxfifo), 0);
+	CHECK_EQ(stats.rx_overflows, 1);
+	CHECK_EQ(RFERRF, 0);
+}
+
+static void
+test_tx_underflow(void)
+{
+	setup();
+
+	CHECK_EQ(tx_prepare(sizeof(frame) - 2), 0);
+	tx_now();
+	hw_queue_clear(&hw_rfst);
+
+	hw_flags_set(&RFERRF, RFERRF_TXUNDERF);
+	rferr_isr();
+
+	CHECK_EQ(hw_queue_pop(&hw_rfst), CSP_IMM_CMD_STROBE(CSP_CMD_FLUSHTX));
+	CHECK(!tx_busy);
+	CHECK_EQ(report_status, IEEE802154_SYSTEM_ERROR);
+	CHECK_EQ(stats.tx_errors, 1);
+}
+
+int
+main(void)
+{
+	RUN(test_setup);
+	RUN(test_rx);
+	RUN(test_rx_masked);
+	RUN(test_tx_done);
+	RUN(test_csma_fail);
+	RUN(test_tx_and_rx);
+	RUN(test_rx_overflow);
+	RUN(test_tx_underflow);
+
+	return check_summary();
+}
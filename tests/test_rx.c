@@ -0,0 +1,378 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+// Frames go through the mocked rx fifo, and come out on the usb rx endpoint.
+// The real rx.c is included, as the rx fifo buffer and its state are static.
+// What it calls in other modules is stubbed, apart from the ones that only
+// record things.
+
+#include <string.h>
+
+#include "rx.c"
+
+#include "check.h"
+#include "hw.h"
+
+__xdata struct stats stats;
+
+static __bit wakeup_armed;
+static u8 wakeup_requests;
+static u8 polls_absorbed;
+static u8 rx_pkt_done;
+
+__bit
+poll_responder_absorb(void)
+{
+	if (!polls_absorbed)
+		return 0;
+
+	polls_absorbed--;
+	rx_drop();
+	return 1;
+}
+
+void
+indirect_rx_pkt_done(void)
+{
+	rx_pkt_done++;
+}
+
+void
+tx_report_rx_frame(void)
+{
+}
+
+__bit
+usb_remote_wakeup_armed(void)
+{
+	return wakeup_armed;
+}
+
+void
+usb_remote_wakeup_request(void)
+{
+	wakeup_requests++;
+}
+
+// Packets armed on the rx endpoint, in order
+static struct {
+	u8 data[128];
+	u8 len;
+} pkts[8];
+static u8 pkt_count;
+
+static void
+rx_ep_write(u8 ep, u8 reg, u8 val, u8 * bank)
+{
+	// Flushing and clearing data toggle are commands, not values
+	if (ep != RXPKT_EP || reg != 1) {
+		bank[reg] = val;
+		return;
+	}
+
+	if (!(val & USBCSIL_INPKT_RDY))
+		return;
+
+	CHECK(pkt_count < 8);
+	pkts[pkt_count].len = hw_queue_read(&hw_usb_in[RXPKT_EP], pkts[pkt_count].data, 128);
+	pkt_count++;
+
+	// Until host has collected it
+	bank[reg] = USBCSIL_INPKT_RDY;
+}
+
+// Host collects the packet, and firmware gets the endpoint interrupt
+static void
+host_collect(void)
+{
+	hw_usb_ep[RXPKT_EP][1] = 0;
+	rx_usb_intr_handler();
+}
+
+// Radio raises FIFOP, as the rf isr would hand it on
+static void
+fifop(void)
+{
+	if (RADIO.rfirqm0 & RFIRQF0_FIFOP)
+		rx_radio_intr_handler(RFIRQF0_FIFOP);
+}
+
+// Data frame, short addresses, as it is in the rx fifo
+static const u8 data_frame[] = {
+	0x41, 0x88, 0x17, 0x34, 0x12, 0xff, 0xff, 0x01, 0x00,
+	0xaa, 0xbb,
+	0xd0, 0x80 | 0x6b,  // RSSI, CRC_OK and correlation
+};
+
+static void
+rx_frame(u8 seq)
+{
+	u8 psdu[sizeof(data_frame)];
+	memcpy(psdu, data_frame, sizeof(psdu));
+	psdu[2] = seq;
+	hw_rx_frame(psdu, sizeof(psdu));
+}
+
+static void
+setup(void)
+{
+	hw_rxfifo_ram = rxfifo;
+	hw_usb_ep_write = rx_ep_write;
+	pkt_count = 0;
+	wakeup_armed = 0;
+	wakeup_requests = 0;
+	polls_absorbed = 0;
+	rx_pkt_done = 0;
+	early = 0;
+	held = 0;
+	wake_filter = 0xff;
+	memset(&stats, 0, sizeof(stats));
+
+	rx_setup();
+}
+
+static void
+test_setup(void)
+{
+	setup();
+
+	// Flushed twice, to get rid of a frame being received
+	CHECK_EQ(hw_queue_len(&hw_rfst), 2);
+	CHECK_EQ(hw_queue_pop(&hw_rfst), CSP_IMM_CMD_STROBE(CSP_CMD_FLUSHRX));
+	CHECK_EQ(hw_queue_pop(&hw_rfst), CSP_IMM_CMD_STROBE(CSP_CMD_FLUSHRX));
+
+	CHECK_EQ(RADIO.fifop_thr, 127);
+	CHECK_EQ(RADIO.rfirqm0, RFIRQF0_FRAME_ACCEPTED | RFIRQF0_RXPKTDONE | RFIRQF0_FIFOP);
+	CHECK(USB.iie & BIT(RXPKT_EP));
+}
+
+static void
+test_frame(void)
+{
+	setup();
+
+	rx_frame(1);
+	fifop();
+
+	// Everything but the phy header goes to usb
+	CHECK_EQ(pkt_count, 1);
+	CHECK_EQ(pkts[0].len, sizeof(data_frame));
+	CHECK_EQ(pkts[0].data[2], 1);
+	CHECK_EQ(pkts[0].data[sizeof(data_frame) - 1], 0x80 | 0x6b);
+	CHECK_EQ(hw_queue_len(&hw_rxfifo), 0);
+	CHECK_EQ(hw_rxfifo.underruns, 0);
+
+	CHECK_EQ(stats.rx_frames, 1);
+	CHECK_EQ(stats.rx_crc_errors, 0);
+
+	// Masked until usb has sent it
+	CHECK(!(RADIO.rfirqm0 & RFIRQF0_FIFOP));
+	host_collect();
+	CHECK(RADIO.rfirqm0 & RFIRQF0_FIFOP);
+	CHECK_EQ(pkt_count, 1);
+}
+
+static void
+test_crc_error(void)
+{
+	setup();
+
+	u8 psdu[sizeof(data_frame)];
+	memcpy(psdu, data_frame, sizeof(psdu));
+	psdu[sizeof(psdu) - 1] &= 0x7f;
+	hw_rx_frame(psdu, sizeof(psdu));
+	fifop();
+
+	// Host gets it anyway, and looks at CRC_OK itself
+	CHECK_EQ(pkt_count, 1);
+	CHECK_EQ(stats.rx_frames, 1);
+	CHECK_EQ(stats.rx_crc_errors, 1);
+}
+
+// Frames received while usb is busy are delivered one at a time, as the
+// previous one is collected
+static void
+test_frames_while_busy(void)
+{
+	setup();
+
+	rx_frame(1);
+	fifop();
+	rx_frame(2);
+	rx_frame(3);
+	fifop();
+	CHECK_EQ(pkt_count, 1);
+
+	// Re-enabling the interrupt delivers the next frame right away
+	host_collect();
+	CHECK_EQ(pkt_count, 2);
+	CHECK_EQ(pkts[1].data[2], 2);
+
+	host_collect();
+	CHECK_EQ(pkt_count, 3);
+	CHECK_EQ(pkts[2].data[2], 3);
+
+	host_collect();
+	CHECK_EQ(pkt_count, 3);
+	CHECK_EQ(hw_queue_len(&hw_rxfifo), 0);
+	CHECK_EQ(hw_rxfifo.underruns, 0);
+}
+
+// An incomplete frame isn't touched
+static void
+test_partial_frame(void)
+{
+	setup();
+
+	hw_queue_push(&hw_rxfifo, sizeof(data_frame));
+	hw_queue_write(&hw_rxfifo, data_frame, 4);
+	rx_radio_intr_handler(RFIRQF0_FIFOP);
+
+	CHECK_EQ(pkt_count, 0);
+	CHECK_EQ(hw_queue_len(&hw_rxfifo), 5);
+}
+
+static void
+test_peek(void)
+{
+	setup();
+
+	// Wrap around the end of the 128 byte rx fifo
+	for (u8 seq = 0; seq < 12; seq++) {
+		rx_frame(seq);
+		CHECK_EQ(rx_peek(0), sizeof(data_frame));
+		CHECK_EQ(rx_peek(1), 0x41);
+		CHECK_EQ(rx_peek(3), seq);
+		rx_drop();
+	}
+
+	CHECK_EQ(RADIO.rxfirst_ptr, 12 * (1 + sizeof(data_frame)) % 128);
+	CHECK_EQ(pkt_count, 0);
+}
+
+static void
+test_absorbed(void)
+{
+	setup();
+
+	polls_absorbed = 1;
+	rx_frame(1);
+	rx_frame(2);
+	fifop();
+
+	// Absorbed frame is dropped, and the next one is delivered in the same pass
+	CHECK_EQ(pkt_count, 1);
+	CHECK_EQ(pkts[0].data[2], 2);
+	CHECK_EQ(hw_queue_len(&hw_rxfifo), 0);
+}
+
+static void
+test_pkt_done(void)
+{
+	setup();
+
+	rx_radio_intr_handler(RFIRQF0_RXPKTDONE);
+	CHECK_EQ(rx_pkt_done, 1);
+	CHECK_EQ(pkt_count, 0);
+}
+
+static void
+test_remote_wakeup(void)
+{
+	setup();
+
+	// Only data frames wake up host
+	rx_set_wake_filter(BIT(MAC_FRAME_TYPE_DATA));
+	wakeup_armed = 1;
+
+	u8 beacon[sizeof(data_frame)];
+	memcpy(beacon, data_frame, sizeof(beacon));
+	beacon[0] = 0x40;
+	hw_rx_frame(beacon, sizeof(beacon));
+	fifop();
+	CHECK_EQ(wakeup_requests, 0);
+	CHECK_EQ(hw_queue_len(&hw_rxfifo), 0);
+
+	// Held in rx fifo, until host has resumed
+	rx_frame(1);
+	fifop();
+	CHECK_EQ(wakeup_requests, 1);
+	CHECK_EQ(pkt_count, 0);
+	CHECK_EQ(hw_queue_len(&hw_rxfifo), 1 + sizeof(data_frame));
+
+	wakeup_armed = 0;
+	rx_resume();
+	CHECK_EQ(pkt_count, 1);
+	CHECK_EQ(pkts[0].data[2], 1);
+}
+
+static void
+test_early(void)
+{
+	setup();
+	hw_queue_clear(&hw_rfst);
+
+	// Fast boot, receiving before host has configured us
+	rx_early_start();
+	CHECK(rx_early_active());
+	CHECK_EQ(hw_queue_pop(&hw_rfst), CSP_IMM_CMD_STROBE(CSP_CMD_FLUSHRX));
+	CHECK_EQ(hw_queue_pop(&hw_rfst), CSP_IMM_CMD_STROBE(CSP_CMD_FLUSHRX));
+	CHECK_EQ(hw_queue_pop(&hw_rfst), CSP_IMM_CMD_STROBE(CSP_CMD_RXON));
+
+	rx_frame(1);
+	rx_frame(2);
+	fifop();
+	CHECK_EQ(pkt_count, 0);
+	CHECK_EQ(hw_queue_len(&hw_rxfifo), 0);
+
+	// Held back frames go first, one per packet, without flushing the radio
+	rx_frame(3);
+	rx_setup();
+	CHECK(!rx_early_active());
+	CHECK_EQ(hw_queue_len(&hw_rfst), 0);
+	CHECK_EQ(pkt_count, 1);
+	CHECK_EQ(pkts[0].data[2], 1);
+
+	host_collect();
+	CHECK_EQ(pkt_count, 2);
+	CHECK_EQ(pkts[1].data[2], 2);
+
+	host_collect();
+	CHECK_EQ(pkt_count, 3);
+	CHECK_EQ(pkts[2].data[2], 3);
+}
+
+static void
+test_early_full(void)
+{
+	setup();
+
+	rx_early_start();
+	for (u8 seq = 0; seq < 32; seq++) {
+		rx_frame(seq);
+		fifop();
+	}
+
+	// Dropped once the buffer is full
+	CHECK_EQ(early_len, CONFIG_RX_EARLY_BUF_LEN / (1 + sizeof(data_frame)) * (1 + sizeof(data_frame)));
+	CHECK_EQ(hw_queue_len(&hw_rxfifo), 0);
+}
+
+int
+main(void)
+{
+	RUN(test_setup);
+	RUN(test_frame);
+	RUN(test_crc_error);
+	RUN(test_frames_while_busy);
+	RUN(test_partial_frame);
+	RUN(test_peek);
+	RUN(test_absorbed);
+	RUN(test_pkt_done);
+	RUN(test_remote_wakeup);
+	RUN(test_early);
+	RUN(test_early_full);
+
+	return check_summary();
+}
@@ -0,0 +1,429 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+// Frames go to the mocked tx fifo, and the radio's completion flags come
+// back as reports. The real tx.c is included, as the CSMA-CA settings and
+// staged transmit request are static. What it calls in other modules is
+// stubbed, apart from the ones that only record things.
+
+#include <string.h>
+
+#include "tx.c"
+
+#include "check.h"
+#include "hw.h"
+
+__xdata struct stats stats;
+
+static __bit indirect_busy;
+static u8 acks_sent;
+
+static u8 reports;
+static u8 report_status;
+static u8 report_attempts;
+
+__bit
+indirect_tx_busy(void)
+{
+	return indirect_busy;
+}
+
+void
+indirect_ack_sent(void)
+{
+	acks_sent++;
+}
+
+void
+tx_report_start(void)
+{
+}
+
+void
+tx_report_done(u8 status, u8 attempts)
+{
+	reports++;
+	report_status = status;
+	report_attempts = attempts;
+}
+
+void
+tx_report_status(u8 status)
+{
+	reports++;
+	report_status = status;
+	report_attempts = 0;
+}
+
+static const u8 frame[] = { 0x41, 0x88, 0x01, 0x34, 0x12, 0xff, 0xff, 0x01, 0x00, 0xaa };
+
+static void
+setup(void)
+{
+	indirect_busy = 0;
+	acks_sent = 0;
+	reports = 0;
+	memset(&stats, 0, sizeof(stats));
+
+	tx_setup();
+	hw_queue_clear(&hw_rfst);
+}
+
+// Same as csma_program() in tools/cspsim.py
+static void
+check_csma_program(u8 be_max)
+{
+	static const u8 program[] = {
+		CSP_IMM_CMD_STROBE(CSP_CMD_STOP),
+		CSP_IMM_CMD_STROBE(CSP_CMD_CLEAR),
+		CSP_INSN_INCZ,
+		CSP_INSN_LABEL,
+		CSP_INSN_SKIP(CSP_IF_Y_0, 2),
+		CSP_INSN_RANDXY,
+		CSP_INSN_WAITX,
+		0,  // INCMAXY be_max
+		CSP_INSN_SKIP(CSP_IF_SFD, 3),
+		CSP_INSN_SKIP(CSP_IF_NOT_CCA, 2),
+		CSP_INSN_STROBE(CSP_CMD_TXON),
+		CSP_INSN_STROBE(CSP_CMD_STOP),
+		CSP_INSN_DECZ,
+		CSP_INSN_RPT(CSP_IF_Z_NOT_0),
+		CSP_INSN_INT,
+	};
+	u8 written[sizeof(program)];
+
+	CHECK_EQ(hw_queue_read(&hw_rfst, written, sizeof(written)), sizeof(program));
+	CHECK_MEM(written, program, 7);
+	CHECK_EQ(written[7], CSP_INSN_INCMAXY(be_max));
+	CHECK_MEM(written + 8, program + 8, sizeof(program) - 8);
+}
+
+static void
+send(const u8 * msdu, u8 len)
+{
+	CHECK_EQ(tx_prepare(len), 0);
+	while (len--)
+		RFD = *msdu++;
+}
+
+static void
+test_setup(void)
+{
+	setup();
+
+	CHECK_EQ(RADIO.rfirqm1, RFIRQF1_TXACKDONE | RFIRQF1_TXDONE | RFIRQF1_CSP_MANINT);
+	CHECK(USB.iie & BIT(INT_EP));
+	CHECK(!tx_busy);
+}
+
+static void
+test_prepare(void)
+{
+	setup();
+
+	send(frame, sizeof(frame));
+	CHECK(tx_busy);
+
+	// Flushed first, and the radio adds the FCS
+	CHECK_EQ(hw_queue_pop(&hw_rfst), CSP_IMM_CMD_STROBE(CSP_CMD_FLUSHTX));
+	CHECK_EQ(hw_queue_len(&hw_txfifo), 1 + sizeof(frame));
+	CHECK_EQ(hw_queue_pop(&hw_txfifo), sizeof(frame) + 2);
+
+	tx_abort();
+	CHECK(!tx_busy);
+	CHECK_EQ(hw_queue_pop(&hw_rfst), CSP_IMM_CMD_STROBE(CSP_CMD_FLUSHTX));
+	CHECK_EQ(hw_queue_len(&hw_txfifo), 0);
+}
+
+// A frame for a device that has just polled us is left alone
+static void
+test_prepare_indirect_busy(void)
+{
+	setup();
+
+	indirect_busy = 1;
+	CHECK_EQ(tx_prepare(sizeof(frame)), 1);
+	CHECK(!tx_busy);
+	CHECK_EQ(hw_queue_len(&hw_rfst), 0);
+	CHECK_EQ(hw_queue_len(&hw_txfifo), 0);
+}
+
+// Nor is a frame still waiting to be sent
+static void
+test_prepare_busy(void)
+{
+	setup();
+
+	send(frame, sizeof(frame));
+	hw_queue_clear(&hw_rfst);
+
+	CHECK_EQ(tx_prepare(sizeof(frame) - 1), 1);
+	CHECK(tx_busy);
+	CHECK_EQ(hw_queue_len(&hw_rfst), 0);
+	CHECK_EQ(hw_queue_len(&hw_txfifo), 1 + sizeof(frame));
+	CHECK_EQ(hw_queue_pop(&hw_txfifo), sizeof(frame) + 2);
+
+	// Until it's done
+	tx_radio_intr_handler(RFIRQF1_TXDONE);
+	CHECK_EQ(tx_prepare(sizeof(frame)), 0);
+}
+
+static void
+test_csma_program(void)
+{
+	setup();
+
+	// be_min 3, be_max 5, 4 retries
+	tx_set_csma_params(0x0453);
+	check_csma_program(5);
+
+	send(frame, sizeof(frame));
+	hw_queue_clear(&hw_rfst);
+	tx_csma();
+
+	CHECK_EQ(RADIO.csp.x, 0);
+	CHECK_EQ(RADIO.csp.y, 3);
+	CHECK_EQ(RADIO.csp.z, 4);
+	CHECK_EQ(hw_queue_pop(&hw_rfst), CSP_IMM_CMD_STROBE(CSP_CMD_START));
+}
+
+static void
+test_csma_success(void)
+{
+	setup();
+	tx_set_csma_params(0x0453);
+
+	send(frame, sizeof(frame));
+	tx_csma();
+
+	// Channel was busy once. Z isn't decremented for the successful CCA.
+	RADIO.csp.z = 4;
+	tx_radio_intr_handler(RFIRQF1_TXDONE);
+
+	CHECK(!tx_busy);
+	CHECK_EQ(reports, 1);
+	CHECK_EQ(report_status, IEEE802154_SUCCESS);
+	CHECK_EQ(report_attempts, 2);
+	CHECK_EQ(stats.tx_success, 1);
+}
+
+static void
+test_csma_failure(void)
+{
+	setup();
+	tx_set_csma_params(0x0453);
+
+	send(frame, sizeof(frame));
+	tx_csma();
+
+	RADIO.csp.z = 0;
+	tx_radio_intr_handler(RFIRQF1_CSP_MANINT);
+
+	CHECK(!tx_busy);
+	CHECK_EQ(reports, 1);
+	CHECK_EQ(report_status, IEEE802154_CHANNEL_ACCESS_FAILURE);
+	CHECK_EQ(report_attempts, 5);
+	CHECK_EQ(stats.tx_csma_failures, 1);
+	CHECK_EQ(stats.tx_success, 0);
+}
+
+static void
+test_now(void)
+{
+	setup();
+
+	send(frame, sizeof(frame));
+	hw_queue_clear(&hw_rfst);
+	tx_now();
+	CHECK_EQ(hw_queue_pop(&hw_rfst), CSP_IMM_CMD_STROBE(CSP_CMD_TXON));
+
+	// No CSMA-CA, so no attempts
+	RADIO.csp.z = 7;
+	tx_radio_intr_handler(RFIRQF1_TXDONE);
+	CHECK_EQ(reports, 1);
+	CHECK_EQ(report_status, IEEE802154_SUCCESS);
+	CHECK_EQ(report_attempts, 0);
+}
+
+static void
+test_ack_sent(void)
+{
+	setup();
+
+	tx_radio_intr_handler(RFIRQF1_TXACKDONE);
+	CHECK_EQ(acks_sent, 1);
+	CHECK_EQ(reports, 0);
+}
+
+static void
+stage(const struct tx_params * params, const u8 * msdu, u8 len)
+{
+	u8 __xdata * p = tx_params_begin(sizeof(*params) + len);
+	CHECK(p != NULL);
+	memcpy(p, params, sizeof(*params));
+	memcpy(p + sizeof(*params), msdu, len);
+}
+
+// Overridden parameters are applied for one frame, and restored when done
+static void
+test_params(void)
+{
+	setup();
+
+	RADIO.freqctrl = CHANNEL_TO_FREQCTRL(11);
+	RADIO.txpower = 0xf5;
+	RADIO.cca_thr = -8;
+	tx_set_csma_params(0x0453);
+	hw_queue_clear(&hw_rfst);
+
+	struct tx_params params = {
+		.flags = TX_PARAM_CHANNEL | TX_PARAM_TXPOWER | TX_PARAM_CCA_THR | TX_PARAM_CSMA,
+		.channel = 26,
+		.txpower = 0x05,
+		.cca_thr = -20,
+		.csma = 0x0021,
+	};
+	stage(&params, frame, sizeof(frame));
+	tx_params_send_csma();
+
+	CHECK(tx_busy);
+	CHECK_EQ(RADIO.freqctrl, CHANNEL_TO_FREQCTRL(26));
+	CHECK_EQ(RADIO.txpower, 0x05);
+	CHECK_EQ(RADIO.cca_thr, -20);
+	CHECK_EQ(RADIO.csp.y, 1);
+	CHECK_EQ(RADIO.csp.z, 0);
+
+	CHECK_EQ(hw_queue_pop(&hw_rfst), CSP_IMM_CMD_STROBE(CSP_CMD_FLUSHTX));
+	check_csma_program(2);
+	CHECK_EQ(hw_queue_pop(&hw_rfst), CSP_IMM_CMD_STROBE(CSP_CMD_START));
+	CHECK_EQ(hw_queue_len(&hw_txfifo), 1 + sizeof(frame));
+
+	tx_radio_intr_handler(RFIRQF1_TXDONE);
+	CHECK_EQ(report_status, IEEE802154_SUCCESS);
+	CHECK_EQ(RADIO.freqctrl, CHANNEL_TO_FREQCTRL(11));
+	CHECK_EQ(RADIO.txpower, 0xf5);
+	CHECK_EQ(RADIO.cca_thr, -8);
+	check_csma_program(5);
+	CHECK_EQ(hw_queue_len(&hw_rfst), 0);
+}
+
+// Radio is retuned while receiving, before CSMA-CA looks at the channel
+static void
+test_params_retune(void)
+{
+	setup();
+
+	RADIO.freqctrl = CHANNEL_TO_FREQCTRL(11);
+	RADIO.fsmstat0.fsm_ffctrl_state = 6;
+	RADIO.rssistat.rssi_valid = 1;
+
+	struct tx_params params = {
+		.flags = TX_PARAM_CHANNEL,
+		.channel = 15,
+	};
+	stage(&params, frame, sizeof(frame));
+	tx_params_send_csma();
+
+	CHECK_EQ(hw_queue_pop(&hw_rfst), CSP_IMM_CMD_STROBE(CSP_CMD_FLUSHTX));
+	CHECK_EQ(hw_queue_pop(&hw_rfst), CSP_IMM_CMD_STROBE(CSP_CMD_RXON));
+	CHECK_EQ(hw_queue_pop(&hw_rfst), CSP_IMM_CMD_STROBE(CSP_CMD_START));
+
+	tx_radio_intr_handler(RFIRQF1_TXDONE);
+	CHECK_EQ(RADIO.freqctrl, CHANNEL_TO_FREQCTRL(11));
+	CHECK_EQ(hw_queue_pop(&hw_rfst), CSP_IMM_CMD_STROBE(CSP_CMD_RXON));
+}
+
+// Radio never gets a valid RSSI on the new channel
+static void
+test_params_retune_timeout(void)
+{
+	setup();
+
+	RADIO.freqctrl = CHANNEL_TO_FREQCTRL(11);
+	RADIO.txpower = 0xf5;
+	RADIO.fsmstat0.fsm_ffctrl_state = 6;
+	RADIO.rssistat.rssi_valid = 0;
+
+	struct tx_params params = {
+		.flags = TX_PARAM_CHANNEL | TX_PARAM_TXPOWER,
+		.channel = 15,
+		.txpower = 0x05,
+	};
+	stage(&params, frame, sizeof(frame));
+	tx_params_send_csma();
+
+	CHECK(!tx_busy);
+	CHECK_EQ(reports, 1);
+	CHECK_EQ(report_status, IEEE802154_CHANNEL_ACCESS_FAILURE);
+	CHECK_EQ(RADIO.freqctrl, CHANNEL_TO_FREQCTRL(11));
+	CHECK_EQ(RADIO.txpower, 0xf5);
+
+	// Flushed, and back in rx on the original channel, without starting CSP
+	CHECK_EQ(hw_queue_pop(&hw_rfst), CSP_IMM_CMD_STROBE(CSP_CMD_FLUSHTX));
+	CHECK_EQ(hw_queue_pop(&hw_rfst), CSP_IMM_CMD_STROBE(CSP_CMD_RXON));
+	CHECK_EQ(hw_queue_pop(&hw_rfst), CSP_IMM_CMD_STROBE(CSP_CMD_FLUSHTX));
+	CHECK_EQ(hw_queue_pop(&hw_rfst), CSP_IMM_CMD_STROBE(CSP_CMD_RXON));
+	CHECK_EQ(hw_queue_len(&hw_rfst), 0);
+	CHECK_EQ(hw_queue_len(&hw_txfifo), 0);
+
+	// Next transmit goes ahead
+	RADIO.rssistat.rssi_valid = 1;
+	stage(&params, frame, sizeof(frame));
+	tx_params_send_now();
+	CHECK(tx_busy);
+}
+
+static void
+test_params_invalid(void)
+{
+	setup();
+
+	RADIO.freqctrl = CHANNEL_TO_FREQCTRL(11);
+
+	struct tx_params params = {
+		.flags = TX_PARAM_CHANNEL,
+		.channel = 27,
+	};
+	stage(&params, frame, sizeof(frame));
+	tx_params_send_now();
+
+	CHECK(!tx_busy);
+	CHECK_EQ(reports, 1);
+	CHECK_EQ(report_status, IEEE802154_INVALID_PARAMETER);
+	CHECK_EQ(RADIO.freqctrl, CHANNEL_TO_FREQCTRL(11));
+	CHECK_EQ(hw_queue_len(&hw_rfst), 0);
+	CHECK_EQ(hw_queue_len(&hw_txfifo), 0);
+}
+
+static void
+test_params_bounds(void)
+{
+	setup();
+
+	CHECK(tx_params_begin(sizeof(struct tx_params)) == NULL);
+	CHECK(tx_params_begin(sizeof(struct tx_params) + 1) != NULL);
+	CHECK(tx_params_begin(sizeof(struct tx_params) + TX_MAX_LEN) != NULL);
+	CHECK(tx_params_begin(sizeof(struct tx_params) + TX_MAX_LEN + 1) == NULL);
+}
+
+int
+main(void)
+{
+	RUN(test_setup);
+	RUN(test_prepare);
+	RUN(test_prepare_indirect_busy);
+	RUN(test_prepare_busy);
+	RUN(test_csma_program);
+	RUN(test_csma_success);
+	RUN(test_csma_failure);
+	RUN(test_now);
+	RUN(test_ack_sent);
+	RUN(test_params);
+	RUN(test_params_retune);
+	RUN(test_params_retune_timeout);
+	RUN(test_params_invalid);
+	RUN(test_params_bounds);
+
+	return check_summary();
+}
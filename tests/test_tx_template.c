@@ -0,0 +1,278 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "config/misc.h"
+#include "tx.h"
+#include "tx_report.h"
+#include "tx_template.h"
+
+#include "check.h"
+#include "hw.h"
+
+// Stand-ins for tx.c and tx_report.c
+
+static __bit tx_active;
+static int prepared_len;
+static int sent_csma;
+static int sent_now;
+static int reported_status;
+
+__bit
+tx_prepare(u8 msdu_len)
+{
+	if (tx_active)
+		return 1;
+
+	prepared_len = msdu_len;
+	return 0;
+}
+
+void
+tx_csma(void)
+{
+	sent_csma++;
+}
+
+void
+tx_now(void)
+{
+	sent_now++;
+}
+
+void
+tx_report_status(u8 status)
+{
+	reported_status = status;
+}
+
+static void
+setup(void)
+{
+	tx_active = 0;
+	prepared_len = -1;
+	sent_csma = 0;
+	sent_now = 0;
+	reported_status = -1;
+}
+
+static const u8 frame[] = {
+	0x41, 0x88, 0x00, 0xcd, 0xab, 0xff, 0xff, 0x34, 0x12, 0x01, 0x02, 0x03,
+};
+
+static void
+store(u8 id, __bit auto_dsn)
+{
+	u8 __xdata * dst = tx_template_store_begin(id, sizeof(frame), auto_dsn);
+	CHECK(dst != NULL);
+	for (u8 i = 0; i < sizeof(frame); i++)
+		dst[i] = frame[i];
+	tx_template_store_done();
+}
+
+static void
+patch(u8 id, const u8 * p, u8 len)
+{
+	u8 __xdata * dst = tx_template_patch_begin(id, len);
+	CHECK(dst != NULL);
+	if (!dst)
+		return;
+	for (u8 i = 0; i < len; i++)
+		dst[i] = p[i];
+}
+
+// Returns the frame written to the tx fifo
+static u16
+sent(u8 * buf)
+{
+	return hw_queue_read(&hw_txfifo, buf, HW_QUEUE_LEN);
+}
+
+static void
+test_bounds(void)
+{
+	setup();
+
+	CHECK(tx_template_store_begin(CONFIG_TX_TEMPLATE_COUNT, 10, 0) == NULL);
+	CHECK(tx_template_store_begin(0, 0, 0) == NULL);
+	CHECK(tx_template_store_begin(0, TX_TEMPLATE_MAX_LEN + 1, 0) == NULL);
+	CHECK(tx_template_store_begin(0, TX_TEMPLATE_MAX_LEN, 0) != NULL);
+
+	// Not usable until stored completely
+	CHECK(tx_template_patch_begin(0, 0) == NULL);
+	tx_template_store_done();
+	CHECK(tx_template_patch_begin(0, 0) != NULL);
+
+	CHECK(tx_template_patch_begin(0, TX_TEMPLATE_PATCH_MAX_LEN + 1) == NULL);
+	CHECK(tx_template_patch_begin(CONFIG_TX_TEMPLATE_COUNT, 0) == NULL);
+}
+
+static void
+test_send(void)
+{
+	u8 buf[HW_QUEUE_LEN];
+
+	setup();
+	store(1, 0);
+
+	patch(1, NULL, 0);
+	tx_template_send_csma();
+	CHECK_EQ(prepared_len, sizeof(frame));
+	CHECK_EQ(sent_csma, 1);
+	CHECK_EQ(sent(buf), sizeof(frame));
+	CHECK_MEM(buf, frame, sizeof(frame));
+
+	patch(1, NULL, 0);
+	tx_template_send_now();
+	CHECK_EQ(sent_now, 1);
+	CHECK_EQ(sent(buf), sizeof(frame));
+	CHECK_MEM(buf, frame, sizeof(frame));
+
+	CHECK_EQ(reported_status, -1);
+}
+
+static void
+test_auto_dsn(void)
+{
+	u8 buf[HW_QUEUE_LEN];
+
+	setup();
+	store(2, 1);
+
+	// Starts at the DSN it was stored with
+	patch(2, NULL, 0);
+	tx_template_send_csma();
+	sent(buf);
+	CHECK_EQ(buf[2], frame[2]);
+
+	// A patch can't override the DSN
+	const u8 p[] = { 2, 1, 0x55 };
+	patch(2, p, sizeof(p));
+	tx_template_send_csma();
+	CHECK_EQ(sent(buf), sizeof(frame));
+	CHECK_EQ(buf[2], (u8)(frame[2] + 1));
+	CHECK_MEM(buf + 3, frame + 3, sizeof(frame) - 3);
+}
+
+static u8
+send_dsn(u8 id)
+{
+	u8 buf[HW_QUEUE_LEN];
+
+	patch(id, NULL, 0);
+	tx_template_send_csma();
+	sent(buf);
+	return buf[2];
+}
+
+// Every template has its own sequence, and a stored one starts over
+static void
+test_auto_dsn_per_template(void)
+{
+	setup();
+	store(0, 1);
+	store(3, 1);
+
+	CHECK_EQ(send_dsn(0), frame[2]);
+	CHECK_EQ(send_dsn(0), (u8)(frame[2] + 1));
+	CHECK_EQ(send_dsn(3), frame[2]);
+	CHECK_EQ(send_dsn(0), (u8)(frame[2] + 2));
+	CHECK_EQ(send_dsn(3), (u8)(frame[2] + 1));
+
+	store(0, 1);
+	CHECK_EQ(send_dsn(0), frame[2]);
+	CHECK_EQ(send_dsn(3), (u8)(frame[2] + 2));
+
+	// Not maintained, so not counted either
+	store(1, 0);
+	CHECK_EQ(send_dsn(1), frame[2]);
+	CHECK_EQ(send_dsn(1), frame[2]);
+}
+
+static void
+test_patches(void)
+{
+	u8 buf[HW_QUEUE_LEN];
+	u8 expected[sizeof(frame)];
+
+	setup();
+	store(3, 0);
+
+	const u8 p[] = { 0, 1, 0x61, 10, 2, 0xaa, 0xbb };
+	patch(3, p, sizeof(p));
+	tx_template_send_now();
+
+	for (u8 i = 0; i < sizeof(frame); i++)
+		expected[i] = frame[i];
+	expected[0] = 0x61;
+	expected[10] = 0xaa;
+	expected[11] = 0xbb;
+
+	CHECK_EQ(sent(buf), sizeof(frame));
+	CHECK_MEM(buf, expected, sizeof(frame));
+
+	// Patches stick
+	patch(3, NULL, 0);
+	tx_template_send_now();
+	CHECK_EQ(sent(buf), sizeof(frame));
+	CHECK_MEM(buf, expected, sizeof(frame));
+}
+
+static void
+test_invalid_patches(void)
+{
+	static const u8 invalid[][4] = {
+		{ 13, 0, 0, 0 },            // Past the end
+		{ 11, 2, 0, 0 },            // Runs past the end
+		{ 0, 3, 1, 2 },             // Longer than the patch list
+	};
+	u8 buf[HW_QUEUE_LEN];
+
+	for (u8 i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+		setup();
+		store(0, 0);
+
+		patch(0, invalid[i], 4);
+		tx_template_send_csma();
+		CHECK_EQ(reported_status, IEEE802154_INVALID_PARAMETER);
+		CHECK_EQ(prepared_len, -1);
+		CHECK_EQ(sent_csma, 0);
+		CHECK_EQ(sent(buf), 0);
+	}
+
+	// Odd byte left over
+	setup();
+	patch(0, invalid[0], 1);
+	tx_template_send_csma();
+	CHECK_EQ(reported_status, IEEE802154_INVALID_PARAMETER);
+}
+
+static void
+test_tx_active(void)
+{
+	u8 buf[HW_QUEUE_LEN];
+
+	setup();
+	store(0, 0);
+	tx_active = 1;
+
+	patch(0, NULL, 0);
+	tx_template_send_now();
+	CHECK_EQ(reported_status, IEEE802154_TX_ACTIVE);
+	CHECK_EQ(sent_now, 0);
+	CHECK_EQ(sent(buf), 0);
+}
+
+int
+main(void)
+{
+	RUN(test_bounds);
+	RUN(test_send);
+	RUN(test_auto_dsn);
+	RUN(test_auto_dsn_per_template);
+	RUN(test_patches);
+	RUN(test_invalid_patches);
+	RUN(test_tx_active);
+
+	return check_summary();
+}
@@ -0,0 +1,430 @@
+#!/usr/bin/env python3
+# SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+#
+# SPDX-License-Identifier: GPL-3.0-or-later
+
+"""Run Command Strobe Processor programs on the host.
+
+  cspsim.py stats [--be-min 3] [--be-max 5] [--retries 4] [--busy 0.3] [-n 10000]
+  cspsim.py trace [--be-min 3] [--be-max 5] [--retries 4] [--busy 0.3] [--seed 1]
+  cspsim.py check [-n 10000]
+
+The CSMA-CA program is assembled here exactly like write_csp_csma_program()
+in tx.c does it, and is then executed instruction by instruction, against
+a model of the X/Y/Z registers, MAC timer, RANDXY, and the CCA and SFD inputs.
+
+The channel model is simple: every CCA sample is busy with probability
+--busy, and every SFD check finds a frame in the air with probability --sfd.
+
+'stats' reports how often the program ends with a transmit, and how often
+with MANINT (channel access failure), along with the distribution of
+attempts (as reported in TX reports) and time from start to transmit.
+'trace' runs the program once, and prints every instruction executed.
+'check' verifies that the program here is the one in tx.c, and that it
+behaves as intended over a range of parameters. It exits non-zero if not.
+"""
+
+import argparse
+import os
+import random
+import re
+import sys
+
+# MAC timer period, in 32 MHz ticks. See mac_time.h
+MAC_TIMER_PERIOD = 36352
+US_PER_PERIOD = MAC_TIMER_PERIOD / 32
+
+# Instruction encoding, from the CC253x user's guide (CSP chapter)
+SKIP = 0x00     # 0sss nccc: Skip s instructions if condition c (negated if n)
+WAIT = 0x80     # 100w wwww: Wait w MAC timer overflows
+RPT = 0xa0      # 1010 nccc: Repeat from LABEL if condition c (negated if n)
+WEVENT1 = 0xb8
+WEVENT2 = 0xb9
+INT = 0xba
+LABEL = 0xbb
+WAITX = 0xbc
+RANDXY = 0xbd
+SETCMP1 = 0xbe
+INCX = 0xc0
+INCY = 0xc1
+INCZ = 0xc2
+DECX = 0xc3
+DECY = 0xc4
+DECZ = 0xc5
+INCMAXY = 0xc8  # 1100 1mmm: Y = min(Y + 1, m)
+
+# Strobes
+SNOP = 0xd0
+STOP = 0xd2
+SRXON = 0xd3
+STXON = 0xd9
+STXONCCA = 0xda
+SFLUSHRX = 0xdd
+SFLUSHTX = 0xde
+SRFOFF = 0xdf
+
+NEGATE = 0x08
+
+IF_CCA = 0
+IF_SFD = 1
+IF_CPU_CTRL = 2
+IF_X_0 = 4
+IF_Y_0 = 5
+IF_Z_0 = 6
+IF_RSSI_VALID = 7
+
+IF_NOT_CCA = NEGATE | IF_CCA
+IF_Z_NOT_0 = NEGATE | IF_Z_0
+
+CONDITIONS = {
+	IF_CCA: 'CCA',
+	IF_SFD: 'SFD',
+	IF_CPU_CTRL: 'CPU_CTRL',
+	IF_X_0: 'X_0',
+	IF_Y_0: 'Y_0',
+	IF_Z_0: 'Z_0',
+	IF_RSSI_VALID: 'RSSI_VALID',
+}
+
+NAMES = {
+	WEVENT1: 'WEVENT1', WEVENT2: 'WEVENT2', INT: 'INT', LABEL: 'LABEL',
+	WAITX: 'WAITX', RANDXY: 'RANDXY', SETCMP1: 'SETCMP1',
+	INCX: 'INCX', INCY: 'INCY', INCZ: 'INCZ', DECX: 'DECX', DECY: 'DECY', DECZ: 'DECZ',
+	SNOP: 'SNOP', STOP: 'STOP', SRXON: 'SRXON', STXON: 'STXON', STXONCCA: 'STXONCCA',
+	SFLUSHRX: 'SFLUSHRX', SFLUSHTX: 'SFLUSHTX', SRFOFF: 'SRFOFF',
+}
+
+
+def skip(cond, n):
+	return SKIP | (n << 4) | cond
+
+
+def rpt(cond):
+	return RPT | cond
+
+
+def incmaxy(m):
+	return INCMAXY | (m & 7)
+
+
+def csma_program(be_max):
+	"""Same as write_csp_csma_program() in tx.c"""
+	return [
+		INCZ,
+		LABEL,
+			skip(IF_Y_0, 2),
+				RANDXY,
+				WAITX,
+			incmaxy(be_max),
+			skip(IF_SFD, 3),
+			skip(IF_NOT_CCA, 2),
+				STXON,
+				STOP,
+			DECZ,
+		rpt(IF_Z_NOT_0),
+		INT,
+	]
+
+
+def cond_name(c):
+	name = CONDITIONS.get(c & 7, '?')
+	return ('NOT_' if c & NEGATE else '') + name
+
+
+def disasm(insn):
+	if insn < 0x80:
+		return 'SKIP %d, %s' % ((insn >> 4) & 7, cond_name(insn))
+	if insn & 0xe0 == WAIT:
+		return 'WAIT %d' % (insn & 0x1f)
+	if insn & 0xf0 == RPT:
+		return 'RPT %s' % cond_name(insn)
+	if insn & 0xf8 == INCMAXY:
+		return 'INCMAXY %d' % (insn & 7)
+	return NAMES.get(insn, '0x%02x' % insn)
+
+
+class Channel:
+	def __init__(self, busy, sfd, rng):
+		self.busy = busy
+		self.sfd = sfd
+		self.rng = rng
+
+	def cca(self):
+		return self.rng.random() >= self.busy
+
+	def sfd_active(self):
+		return self.rng.random() < self.sfd
+
+
+class Csp:
+	"""Command Strobe Processor, enough of it for the programs we run"""
+
+	def __init__(self, program, channel, rng, trace=None):
+		self.program = program
+		self.channel = channel
+		self.rng = rng
+		self.trace = trace
+		self.x = self.y = self.z = 0
+		self.time = 0       # MAC timer overflows since start
+		self.label = 0
+		self.outcome = None
+		self.backoffs = []  # (X, Y) after each RANDXY
+
+	def cond(self, c):
+		base = c & 7
+		if base == IF_CCA:
+			v = self.channel.cca()
+		elif base == IF_SFD:
+			v = self.channel.sfd_active()
+		elif base == IF_CPU_CTRL:
+			v = False
+		elif base == IF_X_0:
+			v = self.x == 0
+		elif base == IF_Y_0:
+			v = self.y == 0
+		elif base == IF_Z_0:
+			v = self.z == 0
+		else:
+			v = True
+		return not v if c & NEGATE else v
+
+	def run(self, x, y, z, max_steps=100000):
+		for _ in self.steps(x, y, z, max_steps):
+			pass
+		return self.outcome
+
+	def steps(self, x, y, z, max_steps=100000):
+		"""Like run(), but yields after every WAIT and WAITX, for a caller that
+		keeps other programs, and the channel, in step. The number of MAC timer
+		overflows waited is in self.time."""
+		self.x, self.y, self.z = x, y, z
+		pc = 0
+		steps = 0
+
+		while pc < len(self.program):
+			steps += 1
+			if steps > max_steps:
+				raise RuntimeError('program did not stop')
+
+			insn = self.program[pc]
+			if self.trace:
+				self.trace('%5d  %2d: %-16s X=%-3d Y=%d Z=%d' % (
+					self.time, pc, disasm(insn), self.x, self.y, self.z))
+			pc += 1
+
+			if insn < 0x80:
+				if self.cond(insn):
+					pc += (insn >> 4) & 7
+			elif insn & 0xe0 == WAIT:
+				self.time += (insn & 0x1f) or 32
+				yield
+			elif insn & 0xf0 == RPT:
+				if self.cond(insn):
+					pc = self.label
+			elif insn & 0xf8 == INCMAXY:
+				self.y = min(self.y + 1, insn & 7)
+			elif insn == LABEL:
+				self.label = pc
+			elif insn == WAITX:
+				self.time += self.x
+				yield
+			elif insn == RANDXY:
+				self.x = self.rng.getrandbits(8) & ((1 << self.y) - 1)
+				self.backoffs.append((self.x, self.y))
+			elif insn == INCX:
+				self.x = (self.x + 1) & 0xff
+			elif insn == INCY:
+				self.y = (self.y + 1) & 0xff
+			elif insn == INCZ:
+				self.z = (self.z + 1) & 0xff
+			elif insn == DECX:
+				self.x = (self.x - 1) & 0xff
+			elif insn == DECY:
+				self.y = (self.y - 1) & 0xff
+			elif insn == DECZ:
+				self.z = (self.z - 1) & 0xff
+			elif insn in (STXON, STXONCCA):
+				self.outcome = 'tx'
+			elif insn == INT:
+				self.outcome = 'manint'
+			elif insn == STOP:
+				break
+
+		return self.outcome
+
+
+def attempts(retries, z, outcome):
+	"""Same as csma_attempts() in tx.c"""
+	n = retries + 1 - z
+	if outcome == 'tx':
+		n += 1
+	return n
+
+
+def percentile(values, p):
+	if not values:
+		return 0
+	values = sorted(values)
+	return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def stats(args):
+	rng = random.Random(args.seed)
+	program = csma_program(args.be_max)
+
+	outcomes = {'tx': 0, 'manint': 0}
+	hist = {}
+	delays = []
+
+	for _ in range(args.n):
+		csp = Csp(program, Channel(args.busy, args.sfd, rng), rng)
+		outcome = csp.run(0, args.be_min, args.retries)
+		outcomes[outcome] += 1
+
+		n = attempts(args.retries, csp.z, outcome)
+		hist[n] = hist.get(n, 0) + 1
+
+		if outcome == 'tx':
+			delays.append(csp.time * US_PER_PERIOD)
+
+	print('be_min=%d be_max=%d retries=%d busy=%.2f sfd=%.2f runs=%d' % (
+		args.be_min, args.be_max, args.retries, args.busy, args.sfd, args.n))
+	print()
+	print('transmitted:      %6.2f %%' % (100 * outcomes['tx'] / args.n))
+	print('access failure:   %6.2f %%' % (100 * outcomes['manint'] / args.n))
+	print()
+	print('attempts  runs')
+	for n in sorted(hist):
+		print('%8d  %d' % (n, hist[n]))
+	print()
+	print('backoff before transmit, us:')
+	for p in (50, 90, 99, 100):
+		print('  p%-3d %10.0f' % (p, percentile(delays, p)))
+
+
+def trace(args):
+	rng = random.Random(args.seed)
+	csp = Csp(csma_program(args.be_max), Channel(args.busy, args.sfd, rng), rng, trace=print)
+	print(' time  pc  insn')
+	outcome = csp.run(0, args.be_min, args.retries)
+	print('outcome: %s, attempts: %d, backoff: %.0f us' % (
+		outcome, attempts(args.retries, csp.z, outcome), csp.time * US_PER_PERIOD))
+
+
+TX_C = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'tx.c')
+
+
+def tx_c_program(be_max):
+	"""Assemble the RFST = CSP_INSN_*; lines of write_csp_csma_program() in tx.c"""
+	with open(TX_C) as f:
+		src = f.read()
+
+	body = re.search(r'^write_csp_csma_program\(void\)\n\{\n(.*?)^\}', src, re.M | re.S).group(1)
+	names = {'csma_be_max': be_max}
+	for name, value in globals().items():
+		if name.startswith('IF_'):
+			names['CSP_' + name] = value
+		elif name.startswith('S') and name.isupper():
+			names['CSP_CMD_' + name[1:]] = value
+	names['CSP_CMD_STOP'] = STOP
+
+	program = []
+	for m in re.finditer(r'RFST = CSP_INSN_(\w+)(?:\((.*)\))?;', body):
+		insn, args = m.group(1), m.group(2)
+		args = [names[a] if a in names else int(a, 0) for a in args.split(', ')] if args else []
+		if insn == 'SKIP':
+			program.append(skip(*args))
+		elif insn == 'RPT':
+			program.append(rpt(*args))
+		elif insn == 'INCMAXY':
+			program.append(incmaxy(*args))
+		elif insn == 'STROBE':
+			program.append(args[0])
+		else:
+			program.append(globals()[insn])
+	return program
+
+
+def check(args):
+	rng = random.Random(args.seed if args.seed is not None else 1)
+	failures = []
+
+	def expect(ok, what):
+		if not ok:
+			failures.append(what)
+		return ok
+
+	for be_max in range(8):
+		ours, theirs = csma_program(be_max), tx_c_program(be_max)
+		first = not failures
+		if not expect(ours == theirs, 'program differs from tx.c with be_max=%d' % be_max) and first:
+			for i in range(max(len(ours), len(theirs))):
+				a = disasm(ours[i]) if i < len(ours) else '-'
+				b = disasm(theirs[i]) if i < len(theirs) else '-'
+				print('  %2d: %-16s %-16s%s' % (i, a, b, '' if a == b else '  <--'))
+
+	runs = max(1, args.n // 100)
+	for be_min in range(0, 6):
+		for be_max in range(be_min, 8):
+			for retries in (0, 1, 4, 5):
+				params = 'be_min=%d be_max=%d retries=%d' % (be_min, be_max, retries)
+				program = csma_program(be_max)
+
+				for busy in (0.0, 0.5, 1.0):
+					for _ in range(runs):
+						csp = Csp(program, Channel(busy, 0.0, rng), rng)
+						outcome = csp.run(0, be_min, retries)
+						n = attempts(retries, csp.z, outcome)
+
+						expect(1 <= n <= retries + 1,
+							'%s busy=%.1f: %d attempts' % (params, busy, n))
+						if busy == 1.0:
+							expect(outcome == 'manint',
+								'%s: transmitted with the channel always busy' % params)
+						if busy == 0.0:
+							expect(outcome == 'tx' and n == 1,
+								'%s: %s after %d attempts with a clear channel' % (params, outcome, n))
+						for x, y in csp.backoffs:
+							expect(y and x <= (1 << y) - 1,
+								'%s: RANDXY gave X=%d with Y=%d' % (params, x, y))
+						expect(len(csp.backoffs) <= n,
+							'%s: %d backoffs in %d attempts' % (params, len(csp.backoffs), n))
+
+				# First backoff is uniform in 0 to 2^be_min - 1 periods
+				if be_min:
+					seen = set()
+					for _ in range(args.n // 10):
+						csp = Csp(program, Channel(0.0, 0.0, rng), rng)
+						csp.run(0, be_min, retries)
+						seen.add(csp.time)
+					expect(seen == set(range(1 << be_min)),
+						'%s: first backoff took %s periods' % (params, sorted(seen)))
+
+	for f in dict.fromkeys(failures):
+		print('FAIL ' + f)
+	print('%s: %d failures' % ('FAIL' if failures else 'ok', len(failures)))
+	return 1 if failures else 0
+
+
+def main():
+	parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+	parser.add_argument('command', choices=('stats', 'trace', 'check'))
+	parser.add_argument('--be-min', type=int, default=3)
+	parser.add_argument('--be-max', type=int, default=5)
+	parser.add_argument('--retries', type=int, default=4)
+	parser.add_argument('--busy', type=float, default=0.3, help='probability of CCA busy')
+	parser.add_argument('--sfd', type=float, default=0.0, help='probability of frame in the air')
+	parser.add_argument('--seed', type=int, default=None)
+	parser.add_argument('-n', type=int, default=10000, help='number of runs')
+	args = parser.parse_args()
+
+	if args.command == 'stats':
+		stats(args)
+	elif args.command == 'check':
+		sys.exit(check(args))
+	else:
+		trace(args)
+
+
+if __name__ == '__main__':
+	main()
@@ -0,0 +1,237 @@
+#!/usr/bin/env python3
+# SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+#
+# SPDX-License-Identifier: GPL-3.0-or-later
+
+"""Check ISR and request cycle counts against tools/cycle_budgets.txt.
+
+  wpanbench -n 10 profile > profile-1.2-20231120.txt
+  cyclebudget.py check profile-1.2-20231120.txt
+  cyclebudget.py update profile-1.2-20231120.txt [--margin 25] [--run NAME]
+  cyclebudget.py header [--check]
+
+The budgets file is the only place budgets are kept. It has a max and a
+mean cycle count per interrupt handler (rf, rferr, usb, as in enum
+profile_isr in profile.h) and per vendor request (req.tx, req.xdata_read,
+..., as in enum usb_vendor_req in usb/ctrl.h), and the profile run the
+numbers came from, or 'unmeasured'.
+
+The profile is what 'wpanbench profile' prints: max, mean, count, min, and
+over budget count per handler and request, from a firmware built with
+PROFILE_ISR=1.
+
+'check' prints every budget with the measured value and difference, and
+exits non-zero if anything is over its max or mean budget, or ran over the
+firmware's own budget. Budgets that weren't exercised are only reported.
+'update' sets the budgets of everything the profile exercised to what was
+measured plus a margin, and records the run, the profile's file name
+without extension unless given.
+'header' prints config/profile_budgets.h, which the firmware is built with.
+With --check, it exits non-zero if that file is out of date instead.
+"""
+
+import argparse
+import math
+import os
+import re
+import sys
+
+TOP = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+BUDGETS = os.path.join(TOP, 'tools', 'cycle_budgets.txt')
+HEADER = os.path.join(TOP, 'config', 'profile_budgets.h')
+PROFILE_H = os.path.join(TOP, 'profile.h')
+CTRL_H = os.path.join(TOP, 'usb', 'ctrl.h')
+
+UNMEASURED = 'unmeasured'
+
+
+def read_table(path, columns):
+	"""Rows of 'name value...' as {name: {column: value}}, # comments skipped.
+	Columns are numbers, apart from a last one named 'run'."""
+	table = {}
+	with open(path) as f:
+		for line in f:
+			fields = line.split('#', 1)[0].split()
+			if not fields:
+				continue
+			if len(fields) != len(columns) + 1:
+				sys.exit('%s: expected %d columns: %s' % (path, len(columns) + 1, line.strip()))
+			table[fields[0]] = {col: v if col == 'run' else int(v)
+				for col, v in zip(columns, fields[1:])}
+	return table
+
+
+def read_comment(path):
+	"""Leading comment block, kept as is by update"""
+	lines = []
+	with open(path) as f:
+		for line in f:
+			if not line.startswith('#'):
+				break
+			lines.append(line)
+	return lines
+
+
+def enum_names(path, enum, prefix):
+	"""Lower case names of enum members, without prefix, as {name: value}"""
+	with open(path) as f:
+		body = re.search(r'enum %s \{(.*?)\}' % enum, f.read(), re.S).group(1)
+
+	names = {}
+	value = 0
+	for m in re.finditer(r'^\s*%s(\w+)\s*(?:=\s*(\w+))?,' % prefix, body, re.M):
+		if m.group(2):
+			value = int(m.group(2).rstrip('u'), 0)
+		names[m.group(1).lower()] = value
+		value += 1
+	return names
+
+
+def isrs():
+	isrs = enum_names(PROFILE_H, 'profile_isr', 'PROFILE_ISR_')
+	del isrs['count']
+	return isrs
+
+
+def requests():
+	return enum_names(CTRL_H, 'usb_vendor_req', 'USB_REQ_VENDOR_')
+
+
+def check_names(path, table):
+	known = set(isrs()) | {'req.' + r for r in requests()}
+	unknown = sorted(set(table) - known)
+	if unknown:
+		sys.exit('%s: unknown handlers or requests: %s' % (path, ' '.join(unknown)))
+
+
+def check_profile(budgets, profile):
+	failures = 0
+	print('%-22s %-4s %7s %7s %7s  %s' % ('name', '', 'budget', 'cycles', 'diff', 'from'))
+
+	for name, budget in budgets.items():
+		measured = profile.get(name)
+		# rferr only runs on radio errors, which a clean run doesn't have
+		if not measured or not measured['count']:
+			print('%-22s not exercised' % name)
+			continue
+
+		for col in ('max', 'mean'):
+			diff = measured[col] - budget[col]
+			over = diff > 0
+			failures += over
+			print('%-22s %-4s %7d %7d %+7d  %s%s' % (
+				name, col, budget[col], measured[col], diff, budget['run'], '  OVER' if over else ''))
+
+		if measured['over']:
+			print('%-22s %d of %d runs over the firmware budget' % (name, measured['over'], measured['count']))
+			failures += 1
+
+	unmeasured = [name for name, budget in budgets.items() if budget['run'] == UNMEASURED]
+	if unmeasured:
+		print('unmeasured budgets, run update: %s' % ' '.join(unmeasured))
+
+	return failures
+
+
+def update(path, budgets, profile, run, margin):
+	for name, measured in profile.items():
+		if not measured['count']:
+			continue
+		budgets[name] = {
+			'max': math.ceil(measured['max'] * (100 + margin) / 100),
+			'mean': math.ceil(measured['mean'] * (100 + margin) / 100),
+			'run': run,
+		}
+
+	# Handlers first, in enum order, then requests in order of bRequest
+	order = dict(isrs())
+	order.update(('req.' + r, 0x100 + v) for r, v in requests().items())
+
+	lines = read_comment(path)
+	for name in sorted(budgets, key=lambda n: order.get(n, 0x200)):
+		b = budgets[name]
+		lines.append('%-22s %6d %6d  %s\n' % (name, b['max'], b['mean'], b['run']))
+
+	with open(path, 'w') as f:
+		f.writelines(lines)
+
+
+def header(budgets):
+	lines = [
+		'// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall\n',
+		'//\n',
+		'// SPDX-License-Identifier: GPL-3.0-or-later\n',
+		'\n',
+		'// Generated from tools/cycle_budgets.txt by tools/cyclebudget.py header.\n',
+		"// Don't edit, edit the budgets and run make config/profile_budgets.h.\n",
+		'\n',
+		'#pragma once\n',
+		'\n',
+		'// Cycles (32 MHz) per run, counted over budget by the ISR profiler.\n',
+		'// 0: No budget\n',
+		'\n',
+	]
+
+	for isr in isrs():
+		b = budgets.get(isr, {'max': 0, 'run': UNMEASURED})
+		lines.append('#define PROFILE_BUDGET_%-6s %5d  // %s\n' % (isr.upper(), b['max'], b['run']))
+
+	lines.append('\n// Vendor requests, by bRequest\n')
+	lines.append('#define PROFILE_BUDGET_REQS { \\\n')
+	reqs = requests()
+	for req in sorted(reqs, key=reqs.get):
+		b = budgets.get('req.' + req)
+		note = '%s, %s' % (req, b['run']) if b else req
+		lines.append('\t%5d,  /* %s */ \\\n' % (b['max'] if b else 0, note))
+	lines.append('}\n')
+
+	return ''.join(lines)
+
+
+def main():
+	parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+	parser.add_argument('command', choices=('check', 'update', 'header'))
+	parser.add_argument('profile', nargs='?', help="output of 'wpanbench profile'")
+	parser.add_argument('--budgets', default=BUDGETS)
+	parser.add_argument('--margin', type=int, default=25, help='percent over measured, for update')
+	parser.add_argument('--run', help='profile run, for update (default: profile file name)')
+	parser.add_argument('--check', action='store_true', help='check config/profile_budgets.h is up to date')
+	args = parser.parse_args()
+
+	if args.command != 'header' and not args.profile:
+		parser.error('%s needs a profile' % args.command)
+
+	budgets = read_table(args.budgets, ('max', 'mean', 'run'))
+	check_names(args.budgets, budgets)
+
+	if args.command == 'header':
+		text = header(budgets)
+		if not args.check:
+			sys.stdout.write(text)
+			return
+		with open(HEADER) as f:
+			if f.read() != text:
+				sys.exit('%s is out of date, run make config/profile_budgets.h' % HEADER)
+		print('ok')
+		return
+
+	profile = read_table(args.profile, ('max', 'mean', 'count', 'min', 'over'))
+	check_names(args.profile, profile)
+
+	if args.command == 'update':
+		run = args.run or os.path.splitext(os.path.basename(args.profile))[0]
+		if not run or run == UNMEASURED or any(c.isspace() for c in run):
+			parser.error('run must be a single word, other than %s' % UNMEASURED)
+		update(args.budgets, budgets, profile, run, args.margin)
+		print('updated %s, run make config/profile_budgets.h' % args.budgets)
+		return
+
+	failures = check_profile(budgets, profile)
+	if failures:
+		print('FAIL: %d over budget' % failures)
+		sys.exit(1)
+	print('ok')
+
+
+if __name__ == '__main__':
+	main()
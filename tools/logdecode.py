@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+# SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+#
+# SPDX-License-Identifier: GPL-3.0-or-later
+
+"""Decode tokenized log output (make LOG_FORMAT=tokenized).
+
+  logdecode.py table wpan_fw.ihx > wpan_fw.logtab
+  logdecode.py decode wpan_fw.logtab < /dev/ttyUSB0
+
+Record format is described in log.S. The string table maps the code
+address of every NUL terminated string in the firmware image to the
+string, so it has to come from the very image running on the device.
+"""
+
+import sys
+
+LEVELS = 'DIWE'
+
+
+def read_ihx(path):
+	mem = {}
+	base = 0
+	with open(path) as f:
+		for line in f:
+			line = line.strip()
+			if not line.startswith(':'):
+				continue
+			rec = bytes.fromhex(line[1:])
+			n, addr, typ = rec[0], (rec[1] << 8) | rec[2], rec[3]
+			data = rec[4:4 + n]
+			if typ == 0:
+				for i, b in enumerate(data):
+					mem[base + addr + i] = b
+			elif typ == 4:
+				base = ((data[0] << 8) | data[1]) << 16
+	return mem
+
+
+def strings(mem, min_len=2):
+	start = None
+	for addr in sorted(mem):
+		b = mem[addr]
+		if start is not None and addr != prev + 1:
+			start = None
+		if 0x20 <= b < 0x7f:
+			if start is None:
+				start = addr
+		elif b == 0 and start is not None:
+			if addr - start >= min_len:
+				yield start, bytes(mem[a] for a in range(start, addr)).decode()
+			start = None
+		else:
+			start = None
+		prev = addr
+
+
+def make_table(ihx):
+	for addr, s in strings(read_ihx(ihx)):
+		# Any suffix of a string is a valid id too
+		for i in range(len(s) - 1):
+			print('%04x\t%s' % (addr + i, s[i:]))
+
+
+def read_table(path):
+	table = {}
+	with open(path) as f:
+		for line in f:
+			addr, _, s = line.rstrip('\n').partition('\t')
+			table[int(addr, 16)] = s
+	return table
+
+
+def records(data, table):
+	i = 0
+	while i + 3 <= len(data):
+		hdr = data[i]
+		size = hdr & 3
+		# Not a record header, or unknown string: resync on next byte
+		if hdr & 0xf0 != 0x80 or size == 3:
+			i += 1
+			continue
+		# Rest of record is in the next read
+		if i + 3 + size > len(data):
+			break
+		id = data[i + 1] | (data[i + 2] << 8)
+		if id not in table:
+			i += 1
+			continue
+		arg = int.from_bytes(data[i + 3:i + 3 + size], 'little')
+		yield LEVELS[(hdr >> 2) & 3], table[id], size, arg
+		i += 3 + size
+	return i
+
+
+def decode(tab):
+	table = read_table(tab)
+	buf = b''
+	stream = sys.stdin.buffer
+	while True:
+		chunk = stream.read1(4096) if hasattr(stream, 'read1') else stream.read(4096)
+		if not chunk:
+			break
+		buf += chunk
+		gen = records(buf, table)
+		try:
+			while True:
+				lvl, s, size, arg = next(gen)
+				if size:
+					print('%s: %s: %0*X' % (lvl, s, size * 2, arg), flush=True)
+				else:
+					print('%s: %s' % (lvl, s), flush=True)
+		except StopIteration as e:
+			buf = buf[e.value:]
+
+
+def main():
+	if len(sys.argv) == 3 and sys.argv[1] == 'table':
+		make_table(sys.argv[2])
+	elif len(sys.argv) == 3 and sys.argv[1] == 'decode':
+		decode(sys.argv[2])
+	else:
+		sys.exit(__doc__)
+
+
+if __name__ == '__main__':
+	main()
@@ -0,0 +1,796 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+// Userspace client and benchmark for the WPAN adapter firmware, using the
+// vendor protocol described in README.md. No kernel driver needed.
+//
+//   cc -O2 -o wpanbench wpanbench.c $(pkg-config --cflags --libs libusb-1.0)
+//
+//   wpanbench [options] reg                Read XDATA round trips
+//   wpanbench [options] tx                 Transmit, wait for status
+//   wpanbench [options] flood              Transmit back to back, statuses collected async
+//   wpanbench [options] rx                 Count received frames
+//   wpanbench [options] pingpong           Transmit on one adapter, receive on another
+//   wpanbench [options] profile            ISR cycles over frame lengths and EP0 sizes
+//
+// Options:
+//   -d VID:PID   USB device (default 1608:154f)
+//   -i N         Use the N'th matching device (default 0)
+//   -p N         Peer device for pingpong (default 1)
+//   -n COUNT     Number of iterations (default 1000)
+//   -l LEN       Frame length, without FCS (default 21, the minimum)
+//   -c CHANNEL   Set channel 11-26 first
+//   -a ADDR      XDATA address for reg (default CHIPID)
+//   -s SECONDS   Duration of rx (default 10)
+//   -C           Transmit with CSMA-CA
+//   -S BYTES     Fail if less than BYTES of stack were never used
+//
+// After every command, the deepest the stack has been since boot is
+// printed, as a # comment.
+//
+// The device is found by VID:PID only, so a software stand-in (e.g. a gadget
+// on dummy_hcd, or a usbip export) works just as well as a real dongle.
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libusb.h>
+
+#define DEFAULT_VID 0x1608
+#define DEFAULT_PID 0x154f
+
+#define INT_EP   0x81
+#define RXPKT_EP 0x85
+
+#define RT_VENDOR_OUT 0x40
+#define RT_VENDOR_IN  0xc0
+
+enum {
+	REQ_XDATA_READ = 0x00,
+	REQ_XDATA_WRITE = 0x01,
+	REQ_TX = 0x04,
+	REQ_SET_TX_REPORT = 0x0d,
+	REQ_SET_NOTIFY = 0x0e,
+	REQ_GET_PROFILE = 0x12,
+	REQ_GET_MEM_USAGE = 0x16,
+};
+
+#define REG_CHIPID   0x624a
+#define REG_FREQCTRL 0x618f
+#define REG_RFST     0x70e1
+
+// Immediate RXON strobe, restarts rx on the current channel
+#define RFST_ISRXON  0xe3
+
+#define MAX_FRAME_LEN 125
+#define TIMEOUT_MS    1000
+
+// Frame header: data frame, PAN ID compression, short addresses, no ACK
+static const uint8_t mhr[] = {
+	0x41, 0x88, // FCF
+	0x00,       // DSN
+	0xff, 0xff, // PAN ID
+	0xff, 0xff, // Destination
+	0x57, 0x42, // Source
+};
+
+// Payload: u32 sequence number, u64 host time stamp in ns
+#define PAYLOAD_OFFSET sizeof(mhr)
+#define MIN_FRAME_LEN  (PAYLOAD_OFFSET + 12)
+
+static struct {
+	uint16_t vid;
+	uint16_t pid;
+	int index;
+	int peer;
+	unsigned count;
+	unsigned len;
+	int channel;
+	uint16_t addr;
+	unsigned seconds;
+	int csma;
+	int stack_min;
+} opt = {
+	.vid = DEFAULT_VID,
+	.pid = DEFAULT_PID,
+	.index = 0,
+	.peer = 1,
+	.count = 1000,
+	.len = MIN_FRAME_LEN,
+	.channel = 0,
+	.addr = REG_CHIPID,
+	.seconds = 10,
+	.csma = 0,
+	.stack_min = -1,
+};
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void
+die(const char * what, int err)
+{
+	fprintf(stderr, "%s: %s\n", what, err < 0 ? libusb_strerror(err) : strerror(err));
+	exit(1);
+}
+
+static libusb_device_handle *
+open_device(int index)
+{
+	libusb_device ** list;
+	ssize_t n = libusb_get_device_list(NULL, &list);
+	if (n < 0)
+		die("libusb_get_device_list", n);
+
+	libusb_device_handle * h = NULL;
+	int found = 0;
+
+	for (ssize_t i = 0; i < n && !h; i++) {
+		struct libusb_device_descriptor desc;
+		if (libusb_get_device_descriptor(list[i], &desc))
+			continue;
+		if (desc.idVendor != opt.vid || desc.idProduct != opt.pid)
+			continue;
+		if (found++ != index)
+			continue;
+
+		int err = libusb_open(list[i], &h);
+		if (err)
+			die("libusb_open", err);
+	}
+
+	libusb_free_device_list(list, 1);
+
+	if (!h) {
+		fprintf(stderr, "Device %04x:%04x #%d not found\n", opt.vid, opt.pid, index);
+		exit(1);
+	}
+
+	libusb_set_auto_detach_kernel_driver(h, 1);
+
+	int err = libusb_claim_interface(h, 0);
+	if (err)
+		die("libusb_claim_interface", err);
+
+	return h;
+}
+
+static void
+vendor_out(libusb_device_handle * h, uint8_t req, uint16_t value, uint16_t index, uint8_t * data, uint16_t len)
+{
+	int err = libusb_control_transfer(h, RT_VENDOR_OUT, req, value, index, data, len, TIMEOUT_MS);
+	if (err < 0)
+		die("control out", err);
+}
+
+static void
+setup_device(libusb_device_handle * h)
+{
+	// One status byte per interrupt packet
+	vendor_out(h, REQ_SET_TX_REPORT, 0, 0, NULL, 0);
+	vendor_out(h, REQ_SET_NOTIFY, 0, 0, NULL, 0);
+
+	if (opt.channel) {
+		uint8_t freq = 11 + 5 * (opt.channel - 11);
+		vendor_out(h, REQ_XDATA_WRITE, REG_FREQCTRL, 0, &freq, 1);
+
+		// Radio only retunes on the next RXON
+		uint8_t strobe = RFST_ISRXON;
+		vendor_out(h, REQ_XDATA_WRITE, REG_RFST, 0, &strobe, 1);
+	}
+}
+
+// Latency samples, in ns
+
+struct samples {
+	uint64_t * v;
+	unsigned n;
+	unsigned cap;
+};
+
+static void
+samples_add(struct samples * s, uint64_t v)
+{
+	if (s->n == s->cap) {
+		s->cap = s->cap ? 2 * s->cap : 1024;
+		s->v = realloc(s->v, s->cap * sizeof(*s->v));
+		if (!s->v)
+			die("realloc", ENOMEM);
+	}
+	s->v[s->n++] = v;
+}
+
+static int
+cmp_u64(const void * a, const void * b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+static void
+samples_report(const char * name, struct samples * s)
+{
+	if (!s->n) {
+		printf("%s: no samples\n", name);
+		return;
+	}
+
+	qsort(s->v, s->n, sizeof(*s->v), cmp_u64);
+
+	static const unsigned pct[] = {50, 90, 99, 100};
+
+	printf("%s: %u samples, us:", name, s->n);
+	for (unsigned i = 0; i < sizeof(pct) / sizeof(pct[0]); i++) {
+		unsigned k = (uint64_t)(s->n - 1) * pct[i] / 100;
+		printf("  p%u %.1f", pct[i], s->v[k] / 1000.0);
+	}
+	printf("\n");
+}
+
+static unsigned
+build_frame(uint8_t * frame, uint32_t seq)
+{
+	unsigned len = opt.len;
+
+	memset(frame, 0, len);
+	memcpy(frame, mhr, sizeof(mhr));
+	frame[2] = seq;
+
+	uint64_t t = now_ns();
+	memcpy(&frame[PAYLOAD_OFFSET], &seq, 4);
+	memcpy(&frame[PAYLOAD_OFFSET + 4], &t, 8);
+
+	return len;
+}
+
+static int
+wait_status(libusb_device_handle * h, uint8_t * status)
+{
+	uint8_t buf[16];
+	int n = 0;
+
+	int err = libusb_interrupt_transfer(h, INT_EP, buf, sizeof(buf), &n, TIMEOUT_MS);
+	if (err)
+		return err;
+	if (n < 1)
+		return LIBUSB_ERROR_IO;
+
+	*status = buf[0];
+	return 0;
+}
+
+static int
+try_transmit(libusb_device_handle * h, uint32_t seq)
+{
+	uint8_t frame[MAX_FRAME_LEN];
+	unsigned len = build_frame(frame, seq);
+
+	int err = libusb_control_transfer(h, RT_VENDOR_OUT, REQ_TX, !opt.csma, seq & 0xff, frame, len, TIMEOUT_MS);
+	return err < 0 ? err : 0;
+}
+
+static void
+transmit(libusb_device_handle * h, uint32_t seq)
+{
+	int err = try_transmit(h, seq);
+	if (err)
+		die("control out", err);
+}
+
+static void
+bench_reg(libusb_device_handle * h)
+{
+	struct samples s = {0};
+	uint8_t v;
+
+	for (unsigned i = 0; i < opt.count; i++) {
+		uint64_t t = now_ns();
+		int err = libusb_control_transfer(h, RT_VENDOR_IN, REQ_XDATA_READ, opt.addr, 0, &v, 1, TIMEOUT_MS);
+		if (err < 0)
+			die("control in", err);
+		samples_add(&s, now_ns() - t);
+	}
+
+	printf("XDATA 0x%04x = 0x%02x\n", opt.addr, v);
+	samples_report("read", &s);
+}
+
+static void
+bench_tx(libusb_device_handle * h)
+{
+	struct samples s = {0};
+	unsigned failed = 0;
+	uint64_t start = now_ns();
+
+	for (unsigned i = 0; i < opt.count; i++) {
+		uint64_t t = now_ns();
+		transmit(h, i);
+
+		uint8_t status;
+		int err = wait_status(h, &status);
+		if (err)
+			die("status", err);
+
+		if (status)
+			failed++;
+		else
+			samples_add(&s, now_ns() - t);
+	}
+
+	// One request at a time, see bench_flood() for back to back
+	double secs = (now_ns() - start) / 1e9;
+
+	samples_report("tx request to status", &s);
+	printf("%.1f frames/s, %.1f kbit/s, failed: %u\n",
+		opt.count / secs, opt.count * opt.len * 8 / secs / 1000, failed);
+}
+
+// Transmit requests are sent back to back, without waiting for the status
+// of the previous one. The firmware stalls a request while the tx fifo still
+// holds a frame, and it's sent again. Statuses are collected by an interrupt
+// transfer that is always in flight, so the tx fifo is refilled as soon as
+// the firmware lets go of it.
+
+struct flood_state {
+	unsigned statuses;
+	unsigned failed;
+	int stop;
+};
+
+static void LIBUSB_CALL
+status_done(struct libusb_transfer * xfer)
+{
+	struct flood_state * flood = xfer->user_data;
+
+	if (xfer->status == LIBUSB_TRANSFER_COMPLETED && xfer->actual_length > 0) {
+		flood->statuses++;
+		if (xfer->buffer[0])
+			flood->failed++;
+	}
+
+	if (flood->stop || xfer->status == LIBUSB_TRANSFER_NO_DEVICE) {
+		xfer->user_data = NULL;
+		return;
+	}
+
+	int err = libusb_submit_transfer(xfer);
+	if (err)
+		die("libusb_submit_transfer", err);
+}
+
+static void
+bench_flood(libusb_device_handle * h)
+{
+	static uint8_t buf[16];
+	struct flood_state flood = {0};
+	unsigned refused = 0;
+
+	struct libusb_transfer * xfer = libusb_alloc_transfer(0);
+	libusb_fill_interrupt_transfer(xfer, h, INT_EP, buf, sizeof(buf), status_done, &flood, 0);
+	int err = libusb_submit_transfer(xfer);
+	if (err)
+		die("libusb_submit_transfer", err);
+
+	uint64_t start = now_ns();
+
+	for (unsigned i = 0; i < opt.count; i++) {
+		while ((err = try_transmit(h, i))) {
+			if (err != LIBUSB_ERROR_PIPE)
+				die("control out", err);
+			refused++;
+
+			struct timeval tv = {0, 0};
+			libusb_handle_events_timeout(NULL, &tv);
+		}
+	}
+
+	// The last few statuses
+	uint64_t deadline = now_ns() + TIMEOUT_MS * 1000000ull;
+	while (flood.statuses < opt.count && now_ns() < deadline) {
+		struct timeval tv = {0, 1000};
+		libusb_handle_events_timeout(NULL, &tv);
+	}
+
+	double secs = (now_ns() - start) / 1e9;
+
+	flood.stop = 1;
+	libusb_cancel_transfer(xfer);
+	while (xfer->user_data)
+		libusb_handle_events(NULL);
+	libusb_free_transfer(xfer);
+
+	printf("%.1f frames/s, %.1f kbit/s, refused while busy: %u, failed: %u, no status: %u\n",
+		opt.count / secs, opt.count * opt.len * 8 / secs / 1000, refused, flood.failed,
+		opt.count - flood.statuses);
+}
+
+// Received frames are collected with a few bulk transfers in flight, so the
+// endpoint is never left without a buffer.
+
+#define RX_TRANSFERS 4
+
+struct rx_state {
+	unsigned frames;
+	unsigned bytes;
+	unsigned crc_errors;
+	struct samples latency;
+	int stop;
+};
+
+static void LIBUSB_CALL
+rx_done(struct libusb_transfer * xfer)
+{
+	struct rx_state * rx = xfer->user_data;
+
+	if (xfer->status == LIBUSB_TRANSFER_COMPLETED && xfer->actual_length > 0) {
+		uint8_t * p = xfer->buffer;
+		int n = xfer->actual_length;
+
+		rx->frames++;
+		rx->bytes += n;
+
+		// Last byte: CRC OK (bit 7) and correlation
+		if (!(p[n - 1] & 0x80))
+			rx->crc_errors++;
+		else if (n >= (int)MIN_FRAME_LEN + 2 && !memcmp(p, mhr, 2)) {
+			uint64_t t;
+			memcpy(&t, &p[PAYLOAD_OFFSET + 4], 8);
+			samples_add(&rx->latency, now_ns() - t);
+		}
+	}
+
+	if (rx->stop || xfer->status == LIBUSB_TRANSFER_NO_DEVICE) {
+		xfer->user_data = NULL;
+		return;
+	}
+
+	int err = libusb_submit_transfer(xfer);
+	if (err)
+		die("libusb_submit_transfer", err);
+}
+
+static struct libusb_transfer **
+rx_start(libusb_device_handle * h, struct rx_state * rx)
+{
+	static struct libusb_transfer * xfers[RX_TRANSFERS];
+	static uint8_t bufs[RX_TRANSFERS][128];
+
+	for (int i = 0; i < RX_TRANSFERS; i++) {
+		xfers[i] = libusb_alloc_transfer(0);
+		libusb_fill_bulk_transfer(xfers[i], h, RXPKT_EP, bufs[i], sizeof(bufs[i]), rx_done, rx, 0);
+		int err = libusb_submit_transfer(xfers[i]);
+		if (err)
+			die("libusb_submit_transfer", err);
+	}
+
+	return xfers;
+}
+
+static void
+rx_stop(struct libusb_transfer ** xfers, struct rx_state * rx)
+{
+	rx->stop = 1;
+
+	for (int i = 0; i < RX_TRANSFERS; i++)
+		libusb_cancel_transfer(xfers[i]);
+
+	for (int i = 0; i < RX_TRANSFERS; i++) {
+		while (xfers[i]->user_data)
+			libusb_handle_events(NULL);
+		libusb_free_transfer(xfers[i]);
+	}
+}
+
+static void
+bench_rx(libusb_device_handle * h)
+{
+	struct rx_state rx = {0};
+	struct libusb_transfer ** xfers = rx_start(h, &rx);
+
+	uint64_t end = now_ns() + (uint64_t)opt.seconds * 1000000000u;
+	while (now_ns() < end) {
+		struct timeval tv = {0, 100000};
+		libusb_handle_events_timeout(NULL, &tv);
+	}
+
+	rx_stop(xfers, &rx);
+
+	printf("%u frames, %u bytes in %u s: %.1f frames/s, %u CRC errors\n",
+		rx.frames, rx.bytes, opt.seconds, (double)rx.frames / opt.seconds, rx.crc_errors);
+}
+
+static void
+bench_pingpong(libusb_device_handle * h)
+{
+	libusb_device_handle * peer = open_device(opt.peer);
+	setup_device(peer);
+
+	struct rx_state rx = {0};
+	struct libusb_transfer ** xfers = rx_start(peer, &rx);
+
+	for (unsigned i = 0; i < opt.count; i++) {
+		unsigned before = rx.frames;
+		transmit(h, i);
+
+		uint8_t status;
+		int err = wait_status(h, &status);
+		if (err)
+			die("status", err);
+
+		// Give the peer a moment to deliver the frame
+		uint64_t deadline = now_ns() + 20000000u;
+		while (rx.frames == before && now_ns() < deadline) {
+			struct timeval tv = {0, 1000};
+			libusb_handle_events_timeout(NULL, &tv);
+		}
+	}
+
+	rx_stop(xfers, &rx);
+
+	samples_report("tx request to peer rx", &rx.latency);
+	printf("lost: %u of %u\n", opt.count - rx.latency.n, opt.count);
+
+	libusb_release_interface(peer, 0);
+	libusb_close(peer);
+}
+
+// ISR profile, needs firmware built with PROFILE_ISR=1. Transmits every
+// frame length, and reads XDATA with every EP0 transfer size up to a few
+// packets, count times each. Prints the result per interrupt handler and
+// vendor request, for tools/cyclebudget.py to check against, or update,
+// tools/cycle_budgets.txt.
+
+#define PROFILE_VERSION      3
+#define PROFILE_HIST_BUCKETS 16
+#define PROFILE_MAX_READ     128
+
+// struct profile_isr_stats and profile_req_stats in profile.h, little endian
+#define PROFILE_ISR_SIZE (2 + 2 + 2 + 4 + 2 * PROFILE_HIST_BUCKETS + 2 + 2)
+#define PROFILE_REQ_SIZE (2 + 2 + 2 + 4 + 2)
+
+static const char * const profile_isr_names[] = {"rf", "rferr", "usb"};
+#define PROFILE_ISR_COUNT (sizeof(profile_isr_names) / sizeof(profile_isr_names[0]))
+
+// enum usb_vendor_req in usb/ctrl.h, by bRequest
+static const char * const profile_req_names[] = {
+	"xdata_read", "xdata_write", "fifo_read", "fifo_write", "tx", "set_csma",
+	"tx_template_set", "tx_template", "indirect_queue", "indirect_purge",
+	"set_poll_responder", "get_poll_count", "tx_params", "set_tx_report",
+	"set_notify", "set_wake_filter", "get_sof_time", "set_sof_time",
+	"get_profile", "get_trace", "get_latency", "get_stats", "get_mem_usage",
+	"get_caps", "set_features", "config_write", "config_read",
+	"get_boot_timeline",
+};
+#define PROFILE_REQ_COUNT (sizeof(profile_req_names) / sizeof(profile_req_names[0]))
+
+#define PROFILE_SIZE (3 + PROFILE_ISR_COUNT * PROFILE_ISR_SIZE + PROFILE_REQ_COUNT * PROFILE_REQ_SIZE)
+
+static unsigned
+le(const uint8_t * p, int n)
+{
+	unsigned v = 0;
+	while (n--)
+		v = v << 8 | p[n];
+	return v;
+}
+
+static int
+read_profile(libusb_device_handle * h, int reset, uint8_t * buf)
+{
+	int n = libusb_control_transfer(h, RT_VENDOR_IN, REQ_GET_PROFILE, reset, 0,
+		buf, PROFILE_SIZE, TIMEOUT_MS);
+	if (n == LIBUSB_ERROR_PIPE) {
+		fprintf(stderr, "No ISR profile, firmware not built with PROFILE_ISR=1\n");
+		exit(1);
+	}
+	if (n < 0)
+		die("control in", n);
+	if (n < 3 || buf[0] != PROFILE_VERSION || buf[1] != PROFILE_ISR_COUNT
+	    || buf[2] != PROFILE_REQ_COUNT || n < (int)PROFILE_SIZE) {
+		fprintf(stderr, "Unknown ISR profile version %u\n", buf[0]);
+		exit(1);
+	}
+	return n;
+}
+
+// Count, min, max and total are first in both kinds of stats
+static void
+profile_row(const char * name, const uint8_t * p, unsigned over)
+{
+	unsigned count = le(p, 2);
+	unsigned total = le(p + 6, 4);
+
+	printf("%-20s %6u %6u %6u %6u %6u\n", name,
+		le(p + 4, 2), count ? total / count : 0, count, count ? le(p + 2, 2) : 0, over);
+}
+
+static void
+bench_profile(libusb_device_handle * h)
+{
+	uint8_t buf[PROFILE_SIZE];
+	uint8_t data[PROFILE_MAX_READ];
+	unsigned failed = 0;
+
+	read_profile(h, 1, buf);
+
+	for (unsigned i = 0; i < opt.count; i++) {
+		for (opt.len = MIN_FRAME_LEN; opt.len <= MAX_FRAME_LEN; opt.len++) {
+			transmit(h, i);
+
+			uint8_t status;
+			int err = wait_status(h, &status);
+			if (err)
+				die("status", err);
+			failed += !!status;
+		}
+
+		for (unsigned len = 1; len <= PROFILE_MAX_READ; len++) {
+			int err = libusb_control_transfer(h, RT_VENDOR_IN, REQ_XDATA_READ, opt.addr, 0, data, len, TIMEOUT_MS);
+			if (err < 0)
+				die("control in", err);
+		}
+	}
+
+	read_profile(h, 0, buf);
+
+	printf("# %u x frame length %zu-%u, %u failed, XDATA read 1-%u bytes\n",
+		opt.count, MIN_FRAME_LEN, MAX_FRAME_LEN, failed, PROFILE_MAX_READ);
+	printf("# name                  max   mean  count    min   over\n");
+	for (unsigned i = 0; i < PROFILE_ISR_COUNT; i++) {
+		const uint8_t * p = &buf[3 + i * PROFILE_ISR_SIZE];
+		unsigned over = le(p + 10 + 2 * PROFILE_HIST_BUCKETS + 2, 2);
+
+		profile_row(profile_isr_names[i], p, over);
+	}
+
+	// Only the ones that ran
+	for (unsigned i = 0; i < PROFILE_REQ_COUNT; i++) {
+		const uint8_t * p = &buf[3 + PROFILE_ISR_COUNT * PROFILE_ISR_SIZE + i * PROFILE_REQ_SIZE];
+		char name[32];
+
+		if (!le(p, 2))
+			continue;
+		snprintf(name, sizeof(name), "req.%s", profile_req_names[i]);
+		profile_row(name, p, le(p + 10, 2));
+	}
+}
+
+// struct mem_usage in mem_usage.h
+#define MEM_USAGE_VERSION 1
+#define MEM_USAGE_SIZE    12
+
+// Highest IDATA address the stack has reached since boot, and the bytes
+// above it, or -1 if the firmware can't tell
+static int
+read_stack_peak(libusb_device_handle * h, unsigned * free)
+{
+	uint8_t buf[MEM_USAGE_SIZE];
+
+	int n = libusb_control_transfer(h, RT_VENDOR_IN, REQ_GET_MEM_USAGE, 0, 0, buf, sizeof(buf), TIMEOUT_MS);
+	if (n == LIBUSB_ERROR_PIPE)
+		return -1;
+	if (n < 0)
+		die("control in", n);
+	if (n < 4 || buf[0] != MEM_USAGE_VERSION)
+		return -1;
+
+	if (free)
+		*free = buf[3];
+	return buf[2];
+}
+
+// The peak only ever grows, so the one before the command tells whether
+// this command went deeper than anything since boot
+static int
+check_stack(libusb_device_handle * h, int before)
+{
+	unsigned free;
+	int peak = read_stack_peak(h, &free);
+	if (peak < 0) {
+		printf("# stack: not reported by firmware\n");
+		return opt.stack_min >= 0;
+	}
+
+	printf("# stack: peak 0x%02x, 0x%02x before, %u bytes never used\n", peak, before, free);
+
+	if (opt.stack_min >= 0 && free < (unsigned)opt.stack_min) {
+		fprintf(stderr, "Only %u bytes of stack never used, less than %d\n", free, opt.stack_min);
+		return 1;
+	}
+	return 0;
+}
+
+static void
+usage(const char * prog)
+{
+	fprintf(stderr,
+		"usage: %s [-d vid:pid] [-i n] [-p n] [-n count] [-l len] [-c channel] [-a addr] [-s seconds] [-C] [-S bytes]"
+		" reg|tx|flood|rx|pingpong|profile\n", prog);
+	exit(2);
+}
+
+int
+main(int argc, char ** argv)
+{
+	int c;
+	while ((c = getopt(argc, argv, "d:i:p:n:l:c:a:s:CS:")) != -1) {
+		switch (c) {
+		case 'd': {
+			unsigned vid, pid;
+			if (sscanf(optarg, "%x:%x", &vid, &pid) != 2)
+				usage(argv[0]);
+			opt.vid = vid;
+			opt.pid = pid;
+			break;
+		}
+		case 'i': opt.index = atoi(optarg); break;
+		case 'p': opt.peer = atoi(optarg); break;
+		case 'n': opt.count = strtoul(optarg, NULL, 0); break;
+		case 'l': opt.len = strtoul(optarg, NULL, 0); break;
+		case 'c': opt.channel = atoi(optarg); break;
+		case 'a': opt.addr = strtoul(optarg, NULL, 0); break;
+		case 's': opt.seconds = strtoul(optarg, NULL, 0); break;
+		case 'C': opt.csma = 1; break;
+		case 'S': opt.stack_min = atoi(optarg); break;
+		default: usage(argv[0]);
+		}
+	}
+
+	if (optind != argc - 1)
+		usage(argv[0]);
+
+	if (opt.len < MIN_FRAME_LEN || opt.len > MAX_FRAME_LEN) {
+		fprintf(stderr, "Frame length must be %zu to %d\n", MIN_FRAME_LEN, MAX_FRAME_LEN);
+		return 2;
+	}
+
+	if (opt.channel && (opt.channel < 11 || opt.channel > 26)) {
+		fprintf(stderr, "Channel must be 11 to 26\n");
+		return 2;
+	}
+
+	int err = libusb_init(NULL);
+	if (err)
+		die("libusb_init", err);
+
+	libusb_device_handle * h = open_device(opt.index);
+	setup_device(h);
+
+	int stack_before = read_stack_peak(h, NULL);
+
+	const char * cmd = argv[optind];
+	if (!strcmp(cmd, "reg"))
+		bench_reg(h);
+	else if (!strcmp(cmd, "tx"))
+		bench_tx(h);
+	else if (!strcmp(cmd, "flood"))
+		bench_flood(h);
+	else if (!strcmp(cmd, "rx"))
+		bench_rx(h);
+	else if (!strcmp(cmd, "pingpong"))
+		bench_pingpong(h);
+	else if (!strcmp(cmd, "profile"))
+		bench_profile(h);
+	else
+		usage(argv[0]);
+
+	int ret = check_stack(h, stack_before);
+
+	libusb_release_interface(h, 0);
+	libusb_close(h);
+	libusb_exit(NULL);
+
+	return ret;
+}
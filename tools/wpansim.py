@@ -0,0 +1,488 @@
+#!/usr/bin/env python3
+# SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+#
+# SPDX-License-Identifier: GPL-3.0-or-later
+
+"""Simulate many adapters sharing one IEEE 802.15.4 channel.
+
+  wpansim.py [--nodes 10,20,50] [--rate 10] [--len 50] [--duration 10]
+             [--be-min 3] [--be-max 5] [--retries 4] [--frame-retries 3]
+             [--retry-offload] [--loss 0.0] [--area 20] [--seed 1]
+             [--usb-us 500] [--sleepy 0] [--poll-interval 250]
+             [--indirect-rate 1] [--persistence 1000] [--poll-responder]
+
+Every node runs the CSMA-CA program from tx.c on the Command Strobe
+Processor model in cspsim.py, with its MAC timer at a random phase. Its CCA
+and SFD inputs come from a shared channel, instead of random numbers:
+
+- Frames take 32 us per byte on air (250 kbps), plus 6 bytes of preamble,
+  SFD and length, and start 192 us after STXON (RX to TX turnaround).
+- Nodes are placed at random in an --area x --area m square. Received power
+  is --tx-power minus log-distance path loss, plus fixed per-link shadowing.
+- CCA is busy if the power on air at the node is above --cca-threshold
+  (-81 dBm, the firmware's default). SFD is set while a frame the node can
+  hear is past its preamble.
+- A frame is received if it is above sensitivity, and its power is at least
+  4 dB above noise plus every other frame that overlaps it in time. It is
+  then dropped with probability --loss. Nodes can't receive while sending.
+
+Node 0 is a coordinator. Every other node sends it data frames with ACK
+request, with Poisson arrivals at --rate per second, one at a time, like the
+firmware's single tx fifo. A frame without an ACK within 864 us is retried
+up to --frame-retries times, after --host-latency for the status to reach
+the host and the retry to come back, or right away with --retry-offload. A
+CSMA failure (MANINT) drops the frame, as the host would get
+CHANNEL_ACCESS_FAILURE.
+
+The coordinator is the adapter as the firmware drives it:
+
+- Received frames go into the radio's 128 byte rx fifo, length byte
+  included. The frame at its head is moved to the usb rx endpoint as soon
+  as the endpoint is free, and the host collects it --usb-us later. A frame
+  that doesn't fit overflows the fifo, and the firmware flushes it, losing
+  every frame in it, also the ones already ACKed.
+- The radio ACKs (auto ACK) 192 us after a frame that fit.
+- The first --sleepy end nodes also poll with a data request every
+  --poll-interval ms. The host queues frames for each of them with Poisson
+  arrivals at --indirect-rate per second, in the firmware's 4 indirect
+  slots, for --persistence ms. The ACK to a data request has frame pending
+  set if there is a frame for the node, and the frame is then sent right
+  after the ACK, without CSMA-CA, unless one is already being sent. The
+  node stays in rx for it. With --poll-responder, data requests with
+  nothing pending are absorbed instead of going to the host.
+
+For each node count, it reports goodput (MAC payload the host got from the
+coordinator), latency from arrival to ACK, how many retries and CSMA
+failures it took, and frames lost in the rx fifo. With sleepy nodes, also
+how the indirect frames fared.
+"""
+
+import argparse
+import heapq
+import math
+import random
+
+from cspsim import MAC_TIMER_PERIOD, Csp, csma_program, percentile
+
+US_PER_PERIOD = MAC_TIMER_PERIOD / 32
+US_PER_BYTE = 32
+PHY_HEADER = 6      # Preamble, SFD, PHR
+SYNC_US = 5 * US_PER_BYTE
+TURNAROUND_US = 192
+ACK_LEN = 5
+ACK_WAIT_US = 864   # macAckWaitDuration, 54 symbols
+MAC_OVERHEAD = 11   # Data frame header with short addresses, and FCS
+POLL_LEN = 12       # Data request command, short addresses, and FCS
+FRAME_WAIT_US = 2000  # Time a node stays in rx after frame pending
+
+RX_FIFO_LEN = 128
+INDIRECT_SLOTS = 4  # CONFIG_INDIRECT_QUEUE_LEN
+
+SENSITIVITY = -97
+NOISE = -100
+CAPTURE_DB = 4
+
+
+def mw(dbm):
+	return 10 ** (dbm / 10)
+
+
+class Medium:
+	def __init__(self, nodes, args, rng):
+		self.air = []       # Frames on air, or just ended: (start, end, src, frame)
+		n = len(nodes)
+		self.rssi = [[None] * n for _ in range(n)]
+		for a in range(n):
+			for b in range(a + 1, n):
+				d = max(1.0, math.dist(nodes[a].pos, nodes[b].pos))
+				loss = 40 + 10 * args.path_loss_exp * math.log10(d) + rng.gauss(0, args.shadowing)
+				self.rssi[a][b] = self.rssi[b][a] = args.tx_power - loss
+
+	def send(self, now, src, frame):
+		start = now + TURNAROUND_US
+		end = start + (PHY_HEADER + frame.len) * US_PER_BYTE
+		tx = (start, end, src, frame)
+		self.air.append(tx)
+		return tx
+
+	def expire(self, now):
+		# Kept until nothing on air could still overlap them
+		longest = (PHY_HEADER + 127) * US_PER_BYTE + TURNAROUND_US
+		self.air = [tx for tx in self.air if tx[1] > now - longest]
+
+	def power(self, node, t0, t1, exclude=None):
+		"""Power on air at node from t0 to t1, mW, other than exclude"""
+		return sum(mw(self.rssi[tx[2]][node]) for tx in self.air
+			if tx is not exclude and tx[2] != node and tx[0] < t1 and tx[1] > t0)
+
+	def cca(self, node, now):
+		p = self.power(node, now - 128, now)
+		return not p or 10 * math.log10(p) < self.cca_threshold
+
+	def sfd(self, node, now):
+		return any(tx[2] != node and tx[0] + SYNC_US <= now < tx[1]
+			and self.rssi[tx[2]][node] >= SENSITIVITY for tx in self.air)
+
+	def received(self, tx, node):
+		start, end, src, _ = tx
+		rssi = self.rssi[src][node]
+		if rssi < SENSITIVITY:
+			return 'weak'
+		if any(other[2] == node and other[0] < end and other[1] > start for other in self.air):
+			return 'busy'
+		interference = mw(NOISE) + self.power(node, start, end, exclude=tx)
+		if rssi - 10 * math.log10(interference) < CAPTURE_DB:
+			return 'collision'
+		return 'ok'
+
+
+class Frame:
+	def __init__(self, seq, src, length, arrival, kind='data'):
+		self.seq = seq
+		self.src = src
+		self.len = length
+		self.arrival = arrival
+		self.kind = kind
+		self.retries = 0
+		self.ack = False
+		self.pending = False
+
+
+class Adapter:
+	"""The coordinator's radio fifos and indirect queue, and the usb rx endpoint"""
+
+	def __init__(self):
+		self.fifo = []          # (frame kind, seq, bytes, frame pending in ACK)
+		self.fifo_used = 0
+		self.usb_busy = False   # Until host has collected the frame on the endpoint
+		self.slots = []         # Indirect frames: [node id, expiry]
+		self.tx_busy = False    # An indirect frame is in the tx fifo
+
+	def rx_fits(self, frame):
+		return self.fifo_used + 1 + frame.len <= RX_FIFO_LEN
+
+	def rx_push(self, frame, pending):
+		self.fifo.append((frame.kind, frame.seq, 1 + frame.len, pending))
+		self.fifo_used += 1 + frame.len
+
+	def rx_pop(self):
+		entry = self.fifo.pop(0)
+		self.fifo_used -= entry[2]
+		return entry
+
+	def rx_flush(self):
+		lost = len(self.fifo)
+		self.fifo = []
+		self.fifo_used = 0
+		return lost
+
+	def slot_for(self, node):
+		return next((slot for slot in self.slots if slot[0] == node), None)
+
+
+class NodeChannel:
+	"""Channel inputs of one node's CSP, from the shared medium"""
+
+	def __init__(self, sim, node):
+		self.sim = sim
+		self.node = node
+
+	def cca(self):
+		return self.sim.medium.cca(self.node.id, self.sim.now)
+
+	def sfd_active(self):
+		return self.sim.medium.sfd(self.node.id, self.sim.now)
+
+
+class Node:
+	def __init__(self, id, pos, rng):
+		self.id = id
+		self.pos = pos
+		self.phase = rng.uniform(0, US_PER_PERIOD)
+		self.queue = []
+		self.busy = False
+		self.sleepy = False
+
+	def overflow(self, now, n):
+		"""Time of the n'th MAC timer overflow after now"""
+		k = math.floor((now - self.phase) / US_PER_PERIOD)
+		return self.phase + (k + n) * US_PER_PERIOD
+
+
+class Sim:
+	def __init__(self, n, args, seed):
+		self.args = args
+		self.rng = random.Random(seed)
+		self.now = 0.0
+		self.events = []
+		self.seq = 0
+		self.program = csma_program(args.be_max)
+
+		side = args.area
+		self.nodes = [Node(0, (side / 2, side / 2), self.rng)]
+		for i in range(1, n + 1):
+			self.nodes.append(Node(i, (self.rng.uniform(0, side), self.rng.uniform(0, side)), self.rng))
+
+		for node in self.nodes[1:args.sleepy + 1]:
+			node.sleepy = True
+
+		self.medium = Medium(self.nodes, args, self.rng)
+		self.medium.cca_threshold = args.cca_threshold
+		self.adapter = Adapter()
+
+		self.stats = {
+			'offered': 0, 'delivered': 0, 'duplicates': 0, 'csma_failures': 0,
+			'no_ack': 0, 'weak': 0, 'busy': 0, 'collision': 0, 'lost': 0,
+			'overflow': 0, 'flushed': 0,
+			'polls': 0, 'poll_failed': 0, 'pending': 0, 'absorbed': 0,
+			'indirect': 0, 'indirect_full': 0, 'indirect_expired': 0,
+			'indirect_sent': 0, 'indirect_delivered': 0,
+		}
+		self.latencies = []
+		self.retries = {}
+		self.delivered = set()
+
+	def at(self, t, fn, *args):
+		self.seq += 1
+		heapq.heappush(self.events, (t, self.seq, fn, args))
+
+	def run(self):
+		end = self.args.duration * 1e6
+		for node in self.nodes[1:]:
+			if self.args.rate:
+				self.at(self.rng.expovariate(self.args.rate) * 1e6, self.arrival, node)
+			if node.sleepy:
+				self.at(self.rng.uniform(0, self.args.poll_interval * 1000), self.poll, node)
+				if self.args.indirect_rate:
+					self.at(self.rng.expovariate(self.args.indirect_rate) * 1e6, self.indirect_arrival, node)
+
+		while self.events:
+			t, _, fn, args = heapq.heappop(self.events)
+			if t > end:
+				break
+			self.now = t
+			fn(*args)
+
+	def arrival(self, node):
+		self.stats['offered'] += 1
+		node.queue.append(Frame(self.stats['offered'], node.id, self.args.len, self.now))
+		if not node.busy:
+			self.next_frame(node)
+		self.at(self.now + self.rng.expovariate(self.args.rate) * 1e6, self.arrival, node)
+
+	def poll(self, node):
+		self.stats['polls'] += 1
+		node.queue.append(Frame(None, node.id, POLL_LEN, self.now, 'poll'))
+		if not node.busy:
+			self.next_frame(node)
+		self.at(self.now + self.args.poll_interval * 1000, self.poll, node)
+
+	def indirect_arrival(self, node):
+		self.stats['indirect'] += 1
+		if len(self.adapter.slots) == INDIRECT_SLOTS:
+			# Queueing request stalls
+			self.stats['indirect_full'] += 1
+		else:
+			slot = [node.id, self.now + self.args.persistence * 1000]
+			self.adapter.slots.append(slot)
+			self.at(slot[1], self.indirect_expire, slot)
+		self.at(self.now + self.rng.expovariate(self.args.indirect_rate) * 1e6, self.indirect_arrival, node)
+
+	def indirect_expire(self, slot):
+		if slot in self.adapter.slots:
+			self.adapter.slots.remove(slot)
+			self.stats['indirect_expired'] += 1
+
+	def next_frame(self, node):
+		if not node.queue:
+			node.busy = False
+			return
+		node.busy = True
+		self.attempt(node, node.queue[0])
+
+	def attempt(self, node, frame):
+		csp = Csp(self.program, NodeChannel(self, node), self.rng)
+		self.step(node, frame, csp, csp.steps(0, self.args.be_min, self.args.retries), 0)
+
+	def step(self, node, frame, csp, steps, waited):
+		# Runs the program until it waits, or is done
+		for _ in steps:
+			if csp.time != waited:
+				self.at(node.overflow(self.now, csp.time - waited), self.step, node, frame, csp, steps, csp.time)
+				return
+
+		if csp.outcome != 'tx':
+			self.stats['csma_failures' if frame.kind == 'data' else 'poll_failed'] += 1
+			self.done(node, frame)
+			return
+
+		tx = self.medium.send(self.now, node.id, frame)
+		self.at(tx[1], self.frame_end, node, frame, tx)
+
+	def frame_end(self, node, frame, tx):
+		self.medium.expire(self.now)
+		status = self.medium.received(tx, 0)
+		if status == 'ok' and self.rng.random() < self.args.loss:
+			status = 'lost'
+
+		adapter = self.adapter
+		if status != 'ok':
+			self.stats[status] += 1
+		elif not adapter.rx_fits(frame):
+			# Incomplete, so not ACKed, and the firmware flushes the rx fifo
+			self.stats['overflow'] += 1
+			self.stats['flushed'] += adapter.rx_flush()
+		else:
+			pending = frame.kind == 'poll' and adapter.slot_for(node.id) is not None
+			adapter.rx_push(frame, pending)
+			self.rx_drain()
+
+			ack = Frame(frame.seq, 0, ACK_LEN, self.now, 'ack')
+			ack.pending = pending
+			tx = self.medium.send(self.now, 0, ack)
+			self.at(tx[1], self.ack_end, node, frame, tx)
+
+		self.at(self.now + ACK_WAIT_US, self.ack_timeout, node, frame)
+
+	def ack_end(self, node, frame, tx):
+		ack = tx[3]
+		if self.medium.received(tx, node.id) == 'ok' and self.rng.random() >= self.args.loss:
+			frame.ack = True
+			frame.pending = ack.pending
+
+		# Frame for the node is loaded when the data request is received, and
+		# sent when the ACK is done, unless another one is still being sent
+		adapter = self.adapter
+		if ack.pending and not adapter.tx_busy:
+			slot = adapter.slot_for(node.id)
+			if slot:
+				adapter.slots.remove(slot)
+				adapter.tx_busy = True
+				self.stats['pending'] += 1
+				tx = self.medium.send(self.now, 0, Frame(None, 0, self.args.len, self.now, 'indirect'))
+				self.at(tx[1], self.indirect_end, node, tx)
+
+	def indirect_end(self, node, tx):
+		self.medium.expire(self.now)
+		self.adapter.tx_busy = False
+		self.stats['indirect_sent'] += 1
+
+		if self.medium.received(tx, node.id) == 'ok' and self.rng.random() >= self.args.loss:
+			self.stats['indirect_delivered'] += 1
+			# Only for air time, the firmware doesn't wait for it
+			self.medium.send(self.now, node.id, Frame(None, node.id, ACK_LEN, self.now, 'ack'))
+
+	def rx_drain(self):
+		adapter = self.adapter
+		while adapter.fifo and not adapter.usb_busy:
+			kind, seq, _, pending = adapter.rx_pop()
+			if kind == 'poll' and not pending and self.args.poll_responder:
+				self.stats['absorbed'] += 1
+				continue
+			adapter.usb_busy = True
+			self.at(self.now + self.args.usb_us, self.rx_collected, kind, seq)
+
+	def rx_collected(self, kind, seq):
+		self.adapter.usb_busy = False
+		if kind == 'data':
+			if seq in self.delivered:
+				self.stats['duplicates'] += 1
+			else:
+				self.delivered.add(seq)
+				self.stats['delivered'] += 1
+		self.rx_drain()
+
+	def ack_timeout(self, node, frame):
+		if frame.ack and frame.pending:
+			# Stays in rx, for the frame the coordinator has for it
+			self.at(self.now + FRAME_WAIT_US, self.done, node, frame)
+		elif frame.ack:
+			if frame.kind == 'data':
+				self.latencies.append(self.now - frame.arrival)
+			self.done(node, frame)
+		elif frame.retries < self.args.frame_retries:
+			frame.retries += 1
+			delay = 0 if self.args.retry_offload else self.args.host_latency
+			self.at(self.now + delay, self.attempt, node, frame)
+		else:
+			self.stats['no_ack' if frame.kind == 'data' else 'poll_failed'] += 1
+			self.done(node, frame)
+
+	def done(self, node, frame):
+		if frame.kind == 'data':
+			self.retries[frame.retries] = self.retries.get(frame.retries, 0) + 1
+		node.queue.pop(0)
+		# Status goes to host, which then sends the next frame
+		self.at(self.now + self.args.host_latency, self.next_frame, node)
+
+
+def report(n, sim, args):
+	s = sim.stats
+	goodput = s['delivered'] * (args.len - MAC_OVERHEAD) * 8 / args.duration / 1000
+	lat = [v / 1000 for v in sim.latencies]
+	done = sum(sim.retries.values()) or 1
+	retries = ' '.join('%d:%4.1f%%' % (r, 100 * sim.retries.get(r, 0) / done)
+		for r in range(args.frame_retries + 1))
+
+	print('%5d %8d %6.1f%% %7.1f %6.1f %6.1f %6.1f %5.1f%% %5.1f%% %6d %6d %6d  %s' % (
+		n, s['offered'], 100 * s['delivered'] / max(1, s['offered']), goodput,
+		percentile(lat, 50), percentile(lat, 90), percentile(lat, 99),
+		100 * s['csma_failures'] / done, 100 * s['no_ack'] / done,
+		s['collision'], s['busy'], s['overflow'] + s['flushed'], retries))
+
+	if args.sleepy:
+		print('      polls %d (%d failed, %d absorbed), indirect %d: %d full, %d expired, '
+			'%d sent with frame pending, %d received' % (
+			s['polls'], s['poll_failed'], s['absorbed'], s['indirect'], s['indirect_full'],
+			s['indirect_expired'], s['indirect_sent'], s['indirect_delivered']))
+
+
+def main():
+	parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+	parser.add_argument('--nodes', default='10,20,30,40,50', help='node counts to run, besides the coordinator')
+	parser.add_argument('--rate', type=float, default=10, help='frames per second per node')
+	parser.add_argument('--len', type=int, default=50, help='frame length, with FCS')
+	parser.add_argument('--duration', type=float, default=10, help='simulated seconds')
+	parser.add_argument('--be-min', type=int, default=3)
+	parser.add_argument('--be-max', type=int, default=5)
+	parser.add_argument('--retries', type=int, default=4, help='CSMA backoffs')
+	parser.add_argument('--frame-retries', type=int, default=3, help='retransmissions without ACK')
+	parser.add_argument('--retry-offload', action='store_true', help='retransmit without a host round trip')
+	parser.add_argument('--host-latency', type=float, default=1000, help='us from status to next request')
+	parser.add_argument('--loss', type=float, default=0.0, help='probability of losing a received frame')
+	parser.add_argument('--area', type=float, default=20, help='side of the square nodes are placed in, m')
+	parser.add_argument('--tx-power', type=float, default=0, help='dBm')
+	parser.add_argument('--cca-threshold', type=float, default=-81, help='dBm')
+	parser.add_argument('--path-loss-exp', type=float, default=3.0)
+	parser.add_argument('--shadowing', type=float, default=4.0, help='standard deviation, dB')
+	parser.add_argument('--usb-us', type=float, default=500, help='us for host to collect a received frame')
+	parser.add_argument('--sleepy', type=int, default=0, help='end nodes that also poll for indirect frames')
+	parser.add_argument('--poll-interval', type=float, default=250, help='ms between data requests')
+	parser.add_argument('--indirect-rate', type=float, default=1, help='indirect frames per second per sleepy node')
+	parser.add_argument('--persistence', type=float, default=1000, help='ms an indirect frame is held')
+	parser.add_argument('--poll-responder', action='store_true', help='absorb data requests with nothing pending')
+	parser.add_argument('--seed', type=int, default=1)
+	args = parser.parse_args()
+
+	if not MAC_OVERHEAD < args.len <= 127:
+		parser.error('--len must be %d to 127' % (MAC_OVERHEAD + 1))
+
+	print('rate=%g/s len=%d be_min=%d be_max=%d retries=%d frame_retries=%d%s loss=%g area=%gm usb=%gus %gs' % (
+		args.rate, args.len, args.be_min, args.be_max, args.retries, args.frame_retries,
+		' retry_offload' if args.retry_offload else '', args.loss, args.area, args.usb_us, args.duration))
+	if args.sleepy:
+		print('sleepy=%d poll_interval=%gms indirect_rate=%g/s persistence=%gms%s' % (
+			args.sleepy, args.poll_interval, args.indirect_rate, args.persistence,
+			' poll_responder' if args.poll_responder else ''))
+	print()
+	print('                                latency, ms         failed       frames lost')
+	print('nodes  offered  deliv  kbit/s    p50    p90    p99   csma  noack   coll   busy rxfifo  retries')
+
+	for n in [int(v) for v in args.nodes.split(',')]:
+		sim = Sim(n, args, args.seed)
+		sim.run()
+		report(n, sim, args)
+
+
+if __name__ == '__main__':
+	main()
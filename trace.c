@@ -0,0 +1,46 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "config/misc.h"
+#include "int.h"
+#include "mac_time.h"
+
+#include "trace.h"
+
+// Host reads the buffer while it's being written, so entries carry their
+// own sequence number. Anything not matching next_seq - len .. next_seq - 1
+// (as read in the header) was overwritten during the read.
+
+static __xdata struct trace buf;
+
+static u8 next;
+
+void
+trace_setup(void)
+{
+	buf.version = TRACE_VERSION;
+	buf.len = CONFIG_TRACE_LEN;
+}
+
+void
+trace(u8 event, u8 arg) __reentrant
+{
+	__critical {
+		__xdata struct trace_entry * e = &buf.entries[next];
+
+		e->seq = buf.next_seq++;
+		e->event = event;
+		e->arg = arg;
+		e->time = mac_time_now();
+
+		if (++next == CONFIG_TRACE_LEN)
+			next = 0;
+	}
+}
+
+const __xdata struct trace *
+trace_buffer(void)
+{
+	return &buf;
+}
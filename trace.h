@@ -0,0 +1,51 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "config/misc.h"
+#include "int.h"
+
+// Post-mortem event trace, readable by host at any time
+
+enum trace_event {
+	TRACE_NONE         = 0,
+	TRACE_RX_FRAME     = 1,  // arg: frame length
+	TRACE_TX_START     = 2,  // arg: 1 if CSMA-CA, 0 if sent immediately
+	TRACE_TX_DONE      = 3,  // arg: status
+	TRACE_CSMA_FAIL    = 4,  // arg: CSMA retries
+	TRACE_RFERR        = 5,  // arg: RFERRF
+	TRACE_USB_RESET    = 6,
+	TRACE_USB_SUSPEND  = 7,
+	TRACE_USB_RESUME   = 8,
+	TRACE_USB_WAKEUP   = 9,  // Remote wakeup signalled
+	TRACE_SLEEP        = 10,
+	TRACE_WAKE         = 11,
+};
+
+#define TRACE_VERSION 1
+
+struct trace_entry {
+	u16 seq;       // Sequence number, to order entries and detect tearing
+	u8 event;      // enum trace_event
+	u8 arg;
+	u32 time;      // MAC time, see mac_time.h
+};
+
+struct trace {
+	u8 version;    // TRACE_VERSION
+	u8 len;        // CONFIG_TRACE_LEN
+	u16 next_seq;  // Entry n is at entries[n % len]
+	struct trace_entry entries[CONFIG_TRACE_LEN];
+};
+
+void
+trace_setup(void);
+
+// Called from both normal and interrupt context, so arguments must be passed
+// on the stack, not in static memory that an interrupt could overwrite
+void
+trace(u8 event, u8 arg) __reentrant;
+
+const __xdata struct trace *
+trace_buffer(void);
@@ -5,11 +5,16 @@
 #include "bsp/csp.h"
 #include "bsp/radio.h"
 #include "bsp/usb.h"
-#include "bsp/mac_timer.h"
 
 #include "usb_config.h"
 
 #include "log.h"
+#include "indirect.h"
+#include "latency.h"
+#include "notify.h"
+#include "stats.h"
+#include "trace.h"
+#include "tx_report.h"
 
 #include "tx.h"
 
@@ -19,54 +24,32 @@ static u8 csma_be_min;
 static u8 csma_be_max;
 static u8 csma_retries;
 
-// CSMA BACK-OFF PERIOD:
-// aUnitBackoffPeriod = aTurnaroundTime + aCcaTime.
-// aTurnaroundTime = 1ms (1 ms expressed in symbol periods, rounded up to the next integer number of symbol periods)
-// aCcaTime = 8 symbol periods
+// Set while a frame is in the tx fifo, waiting to be sent
+__bit tx_busy;
 
-inline void
-setup_mac_timer(void)
-{
-	// NOTE: Apparently mac timer is fed from 32MHz clock undivided!
-	// Symbol rate: 62.5k/s => symbol period: 16us
-	// 32MHz / 62.5Khz = 512 ticks
-	const u16 symbol_period = 32000000/62500;
-	const u16 backoff_period = (8 + 63)*symbol_period;
-	mac_timer_set_period(backoff_period);
+// Set if the frame in tx fifo is sent with CSMA-CA
+static __bit csma_used;
 
-	// Don't reset overflow count (use long overflow period)
-	mac_timer_select_multiplexed_regs(T2M_TIMER, T2OVF_PERIOD);
-	T2MOVF0 = 0xff;
-	T2MOVF1 = 0xff;
-	T2MOVF2 = 0xff;
+// The tx fifo is memory mapped in radio RAM, right after the rx fifo
+static __xdata __at(0x6080) u8 txfifo[128];
 
-	// Set overflow compare 1 count to something like 100 ms => 100 overflows
-	mac_timer_select_multiplexed_regs(T2M_TIMER, T2OVF_CMP1);
-	T2MOVF0 = 100;
-	T2MOVF1 = 0;
-	T2MOVF2 = 0;
-}
+// Transmit request with per-frame parameters, as received from host
+static __xdata struct {
+	struct tx_params params;
+	u8 frame[TX_MAX_LEN];
+} staged;
+static u8 staged_len;
 
-inline void
-reset_and_start_mac_timer(void)
-{
-	// Stop mac timer
-	T2CTRL = 0;
-
-	// Clear count and overflow count
-	mac_timer_select_multiplexed_regs(T2M_TIMER, T2OVF_OVERFLOW);
-	// clear count
-	T2M0 = 0;
-	T2M1 = 0;
+// Register values and settings to restore after transmit, for overridden parameters
+static __xdata struct tx_params saved;
+static u8 overrides;
 
-	// clear overflow count
-	T2MOVF0 = 0;
-	T2MOVF1 = 0;
-	T2MOVF2 = 0;
+#define CHANNEL_TO_FREQCTRL(_ch) (11 + 5*((_ch) - 11))
 
-	// Start mac timer
-	T2CTRL = T2CTRL_RUN;
-}
+// RSSI is valid 8 symbol periods after rx is calibrated (192 us). This is
+// about 1 ms of polling, so a radio that never gets there doesn't keep us
+// spinning in the usb isr.
+#define RSSI_VALID_POLLS 2048
 
 static void
 write_csp_csma_program(void)
@@ -124,35 +107,62 @@ tx_csma(void)
 {
 	LOGD(__func__);
 
+	csma_used = 1;
+	tx_report_start();
+	trace(TRACE_TX_START, 1);
+
 	RADIO.csp.x = 0;
 	RADIO.csp.y = csma_be_min;
 	RADIO.csp.z = csma_retries;
 
 	RFST = CSP_IMM_CMD_STROBE(CSP_CMD_START);
-
-	reset_and_start_mac_timer();
 }
 
 void
 tx_now(void)
 {
 	LOGI(__func__);
+
+	csma_used = 0;
+	tx_report_start();
+	trace(TRACE_TX_START, 0);
+
 	RFST = CSP_IMM_CMD_STROBE(CSP_CMD_TXON);
 }
 
+u8
+tx_peek(u8 n)
+{
+	return txfifo[(u8)(RADIO.txfirst_ptr + n) & 0x7f];
+}
+
 __bit
 tx_prepare(u8 msdu_len)
 {
 	LOGDX8(__func__, msdu_len);
 
+	// Don't clobber a frame waiting to be sent, or one for a device that's
+	// just polled us
+	if (tx_busy || indirect_tx_busy())
+		return 1;
+
 	RFST = CSP_IMM_CMD_STROBE(CSP_CMD_FLUSHTX);
 	RFD = msdu_len + 2;
+	tx_busy = 1;
 
 	return 0;
 }
 
 void
-tx_set_csma_params(u16 packed_params)
+tx_abort(void)
+{
+	LOGD(__func__);
+	RFST = CSP_IMM_CMD_STROBE(CSP_CMD_FLUSHTX);
+	tx_busy = 0;
+}
+
+inline void
+unpack_csma_params(u16 packed_params)
 {
 	u8 l = packed_params;
 	u8 h = packed_params>>8;
@@ -160,6 +170,12 @@ tx_set_csma_params(u16 packed_params)
 	csma_be_min = l&0x7;
 	csma_be_max = (l>>4)&0x7;
 	csma_retries = h;
+}
+
+void
+tx_set_csma_params(u16 packed_params)
+{
+	unpack_csma_params(packed_params);
 
 	LOGDX8("be_min", csma_be_min);
 	LOGDX8("be_max", csma_be_max);
@@ -197,34 +213,243 @@ setup_radio_tx(void)
 void
 tx_setup(void)
 {
+	notify_reset();
 	setup_txstatus_endpoint();
 	setup_radio_tx();
-	setup_mac_timer();
+	tx_busy = 0;
 }
 
+// Status messages are queued, so a status isn't lost if host hasn't
+// collected the previous one yet
+static __xdata u8 status_msg[2];
+
 void
 usb_status_send(u8 status)
 {
-	USB.fifo[INT_EP].fifo = status;
-	usb_select_endpoint(INT_EP);
-	USB.in_ep.csil = USBCSIL_INPKT_RDY;
+	LOGDX8("tx status", status);
 
+	status_msg[0] = status;
+	notify_post(NOTIFY_STATUS, status_msg, 1);
+}
+
+void
+usb_status_send_handle(u8 status, u8 handle)
+{
 	LOGDX8("tx status", status);
+
+	status_msg[0] = status;
+	status_msg[1] = handle;
+	notify_post(NOTIFY_INDIRECT_STATUS, status_msg, 2);
+}
+
+static __bit
+params_invalid(void)
+{
+	const __xdata struct tx_params * p = &staged.params;
+	u8 flags = p->flags;
+
+	if (flags & TX_PARAM_CHANNEL && (p->channel < 11 || p->channel > 26))
+		return 1;
+
+	if (flags & TX_PARAM_CCA_MODE && p->cca_mode > 3)
+		return 1;
+
+	return 0;
+}
+
+static __bit
+rssi_wait_valid(void)
+{
+	u16 polls = RSSI_VALID_POLLS;
+
+	while (!RADIO.rssistat.rssi_valid) {
+		if (!--polls)
+			return 0;
+	}
+
+	return 1;
+}
+
+// Returns non-zero if the radio couldn't be retuned, with only the channel
+// overridden
+static __bit
+apply_params(void)
+{
+	const __xdata struct tx_params * p = &staged.params;
+	u8 flags = p->flags;
+
+	if (flags & TX_PARAM_CHANNEL) {
+		saved.channel = RADIO.freqctrl;
+		RADIO.freqctrl = CHANNEL_TO_FREQCTRL(p->channel);
+		// Recalibrate, and let RSSI settle on the new channel, or the
+		// CCA done by CSMA-CA would be for the one we just left
+		if (RADIO.fsmstat0.fsm_ffctrl_state) {
+			RFST = CSP_IMM_CMD_STROBE(CSP_CMD_RXON);
+			if (!rssi_wait_valid()) {
+				overrides = TX_PARAM_CHANNEL;
+				return 1;
+			}
+		}
+	}
+
+	if (flags & TX_PARAM_TXPOWER) {
+		saved.txpower = RADIO.txpower;
+		RADIO.txpower = p->txpower;
+	}
+
+	if (flags & TX_PARAM_CCA_THR) {
+		saved.cca_thr = RADIO.cca_thr;
+		RADIO.cca_thr = p->cca_thr;
+	}
+
+	if (flags & TX_PARAM_CCA_MODE) {
+		saved.cca_mode = RADIO.ccactrl1.cca_mode;
+		RADIO.ccactrl1.cca_mode = p->cca_mode;
+	}
+
+	if (flags & TX_PARAM_CSMA) {
+		saved.csma = (csma_retries << 8) | (csma_be_max << 4) | csma_be_min;
+		unpack_csma_params(p->csma);
+		write_csp_csma_program();
+	}
+
+	overrides = flags;
+	return 0;
+}
+
+static void
+restore_params(void)
+{
+	u8 flags = overrides;
+	overrides = 0;
+
+	if (flags & TX_PARAM_CHANNEL) {
+		RADIO.freqctrl = saved.channel;
+		// Recalibrate for the original channel, if we're back in rx
+		if (RADIO.fsmstat0.fsm_ffctrl_state)
+			RFST = CSP_IMM_CMD_STROBE(CSP_CMD_RXON);
+	}
+
+	if (flags & TX_PARAM_TXPOWER)
+		RADIO.txpower = saved.txpower;
+
+	if (flags & TX_PARAM_CCA_THR)
+		RADIO.cca_thr = saved.cca_thr;
+
+	if (flags & TX_PARAM_CCA_MODE)
+		RADIO.ccactrl1.cca_mode = saved.cca_mode;
+
+	if (flags & TX_PARAM_CSMA) {
+		unpack_csma_params(saved.csma);
+		write_csp_csma_program();
+	}
+}
+
+u8 __xdata *
+tx_params_begin(u16 len)
+{
+	if (len <= sizeof(struct tx_params) || len > sizeof(struct tx_params) + TX_MAX_LEN)
+		return NULL;
+
+	staged_len = len - sizeof(struct tx_params);
+
+	return (u8 __xdata *)&staged;
+}
+
+static __bit
+write_staged_to_txfifo(void)
+{
+	if (params_invalid()) {
+		tx_report_status(IEEE802154_INVALID_PARAMETER);
+		return 1;
+	}
+
+	u8 len = staged_len;
+	if (tx_prepare(len)) {
+		tx_report_status(IEEE802154_TX_ACTIVE);
+		return 1;
+	}
+
+	if (apply_params()) {
+		tx_abort();
+		restore_params();
+		tx_report_status(IEEE802154_CHANNEL_ACCESS_FAILURE);
+		return 1;
+	}
+
+	__xdata u8 * frame = staged.frame;
+	do {
+		RFD = *frame++;
+	} while (--len);
+
+	return 0;
+}
+
+void
+tx_params_send_csma(void)
+{
+	if (!write_staged_to_txfifo())
+		tx_csma();
+}
+
+void
+tx_params_send_now(void)
+{
+	if (!write_staged_to_txfifo())
+		tx_now();
+}
+
+// Number of clear channel assessments done by the CSMA-CA program in CSP.
+// Z counts down from retries + 1, but isn't decremented for a successful CCA.
+static u8
+csma_attempts(u8 status)
+{
+	if (!csma_used)
+		return 0;
+
+	u8 attempts = csma_retries + 1 - RADIO.csp.z;
+	if (status == IEEE802154_SUCCESS)
+		attempts++;
+
+	return attempts;
+}
+
+void
+tx_done(u8 status)
+{
+	// Before restore_params() puts back the default CSMA parameters
+	u8 attempts = csma_attempts(status);
+
+	tx_busy = 0;
+	restore_params();
+
+	if (status == IEEE802154_SUCCESS) {
+		STATS_INC(tx_success);
+		if (!indirect_tx_busy())
+			latency_tx_sent();
+	} else if (status == IEEE802154_CHANNEL_ACCESS_FAILURE) {
+		STATS_INC(tx_csma_failures);
+	}
+
+	trace(TRACE_TX_DONE, status);
+	tx_report_done(status, attempts);
 }
 
 void
 tx_radio_intr_handler(u8 flags)
 {
 	if (flags & RFIRQF1_CSP_MANINT) {
-		usb_status_send(IEEE802154_CHANNEL_ACCESS_FAILURE);
+		trace(TRACE_CSMA_FAIL, csma_retries);
+		tx_done(IEEE802154_CHANNEL_ACCESS_FAILURE);
 	}
 
 	if (flags & RFIRQF1_TXDONE) {
-		usb_status_send(IEEE802154_SUCCESS);
+		tx_done(IEEE802154_SUCCESS);
 	}
 
 	if (flags & RFIRQF1_TXACKDONE) {
 		LOGD("autoack");
+		indirect_ack_sent();
 	}
 }
 
@@ -236,8 +461,11 @@ tx_usb_intr_handler(void)
 	u8 flags = USB.in_ep.csil;
 
 	if (flags & USBCSIL_SENT_STALL) {
+		STATS_INC(usb_stalls);
 		LOGE("ST EP: STALLED");
 	}
 	
 	USB.in_ep.csil = 0;
+
+	notify_usb_intr_handler();
 }
@@ -3,6 +3,7 @@
 // SPDX-License-Identifier: GPL-3.0-or-later
 
 #pragma once
+#include "bsp/bits.h"
 #include "int.h"
 
 // FIXME: Move to common usb interface header
@@ -155,6 +156,30 @@ enum ieee802154_status {
 	IEEE802154_SYSTEM_ERROR = 0xff,
 };
 
+// Largest MPDU accepted for transmit, excluding FCS (added by radio)
+#define TX_MAX_LEN 125
+
+// Per-frame overrides, in front of the frame in a transmit request
+struct tx_params {
+	u8 flags;      // enum tx_param_flags
+	u8 channel;    // 11-26
+	u8 txpower;    // TXPOWER register value
+	s8 cca_thr;    // CCA threshold in dBm (offset by RSSI_OFFSET)
+	u8 cca_mode;   // 0-3
+	u16 csma;      // Packed like wValue of Set CSMA parameters request
+	u8 _reserved;
+};
+
+enum tx_param_flags {
+	TX_PARAM_CHANNEL  = BIT(0),
+	TX_PARAM_TXPOWER  = BIT(1),
+	TX_PARAM_CCA_THR  = BIT(2),
+	TX_PARAM_CCA_MODE = BIT(3),
+	TX_PARAM_CSMA     = BIT(4),
+};
+
+extern __bit tx_busy;
+
 void
 tx_usb_intr_handler(void);
 
@@ -164,17 +189,41 @@ tx_radio_intr_handler(u8 flags);
 void
 usb_status_send(u8 status);
 
+void
+usb_status_send_handle(u8 status, u8 handle);
+
 void
 tx_setup(void);
 
 void
 tx_set_csma_params(u16 packed_params);
 
+// Length must be 1 to TX_MAX_LEN
 __bit
 tx_prepare(u8 msdu_len);
 
+// Drop a frame that was prepared, but won't be sent
+void
+tx_abort(void);
+
 void
 tx_csma(void);
 
 void
 tx_now(void);
+
+// Peek at byte n of the frame in tx fifo. Byte 0 is the phy header (frame length).
+u8
+tx_peek(u8 n);
+
+void
+tx_done(u8 status);
+
+u8 __xdata *
+tx_params_begin(u16 len);
+
+void
+tx_params_send_csma(void);
+
+void
+tx_params_send_now(void);
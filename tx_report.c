@@ -0,0 +1,202 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "bsp/radio.h"
+
+#include "int.h"
+#include "indirect.h"
+#include "log.h"
+#include "mac_frame.h"
+#include "mac_time.h"
+#include "notify.h"
+#include "rx.h"
+#include "tx.h"
+
+#include "tx_report.h"
+
+// Outcome of transmits is reported on the status endpoint, either as a
+// single status byte (default), or as a struct tx_report.
+//
+// With reports enabled, the report for a frame with ACK request is held
+// back until the ACK is seen in rx fifo, or until it can't arrive anymore.
+// The ACK is still passed on to the host like any other frame.
+//
+// Frames are only seen when they reach the head of the rx fifo, which may
+// be long after they were received, if the host is slow to read them. So the
+// report is held for as long as there are frames in the fifo, up to a limit.
+
+// Longest frame (254 symbols) plus macAckWaitDuration (54 symbols) after SFD,
+// in MAC timer overflows, rounded up
+#define ACK_TIMEOUT 5
+
+// Longest wait for the frames ahead of the ACK to be read by host, ~114 ms
+#define ACK_TIMEOUT_MAX 100
+
+// PHR, FCF, DSN, RSSI, and CRC_OK/correlation
+#define ACK_LEN_IN_FIFO 6
+
+static __bit enabled;
+static __bit waiting_for_ack;
+
+static u8 host_handle;
+static u8 tx_fcf;
+static u8 tx_dsn;
+
+static __xdata struct tx_report report;
+
+void
+tx_report_enable(__bit enable)
+{
+	LOGDX8(__func__, enable);
+	enabled = enable;
+}
+
+__bit
+tx_report_enabled(void)
+{
+	return enabled;
+}
+
+void
+tx_report_set_handle(u8 handle)
+{
+	host_handle = handle;
+}
+
+void
+tx_report_start(void)
+{
+	// MPDU starts at byte 1, after the length byte
+	tx_fcf = tx_peek(1 + MAC_FCF_OFFSET);
+	tx_dsn = tx_peek(1 + MAC_DSN_OFFSET);
+}
+
+static void
+send_report(void)
+{
+	waiting_for_ack = 0;
+
+	LOGDX8("tx report", report.status);
+
+	notify_post(NOTIFY_TX_REPORT, (const __xdata u8 *)&report, sizeof(report));
+}
+
+static void
+init_report(u8 status, u8 handle, u8 flags)
+{
+	// Don't lose a report still waiting for its ACK
+	if (waiting_for_ack)
+		send_report();
+
+	report.version = TX_REPORT_VERSION;
+	report.handle = handle;
+	report.status = status;
+	report.csma_attempts = 0;
+	report.retries = 0;
+	report.flags = flags;
+	report.ack_rssi = 0;
+	report._reserved = 0;
+	report.sfd_time = 0;
+}
+
+void
+tx_report_done(u8 status, u8 csma_attempts)
+{
+	u8 handle = host_handle;
+	u8 flags = 0;
+
+	if (indirect_tx_done(&handle))
+		flags = TX_REPORT_INDIRECT;
+
+	if (!enabled) {
+		if (flags)
+			usb_status_send_handle(status, handle);
+		else
+			usb_status_send(status);
+		return;
+	}
+
+	init_report(status, handle, flags);
+	report.csma_attempts = csma_attempts;
+
+	if (status != IEEE802154_SUCCESS) {
+		send_report();
+		return;
+	}
+
+	report.sfd_time = mac_time_sfd();
+
+	if (tx_fcf & MAC_FCF_ACK_REQUEST)
+		waiting_for_ack = 1;
+	else
+		send_report();
+}
+
+void
+tx_report_status(u8 status)
+{
+	if (!enabled) {
+		usb_status_send(status);
+		return;
+	}
+
+	init_report(status, host_handle, 0);
+	send_report();
+}
+
+void
+tx_report_indirect(u8 status, u8 handle)
+{
+	if (!enabled) {
+		usb_status_send_handle(status, handle);
+		return;
+	}
+
+	init_report(status, handle, TX_REPORT_INDIRECT);
+	send_report();
+}
+
+void
+tx_report_rx_frame(void)
+{
+	if (!waiting_for_ack)
+		return;
+
+	if ((rx_peek(0) & 0x7f) != ACK_LEN_IN_FIFO - 1)
+		return;
+
+	u8 fcf = rx_peek(1 + MAC_FCF_OFFSET);
+
+	if (MAC_FCF_TYPE(fcf) != MAC_FRAME_TYPE_ACK)
+		return;
+
+	if (rx_peek(1 + MAC_DSN_OFFSET) != tx_dsn)
+		return;
+
+	// CRC_OK
+	if (!(rx_peek(ACK_LEN_IN_FIFO - 1) & 0x80))
+		return;
+
+	report.flags |= TX_REPORT_ACK_RECEIVED;
+	if (fcf & MAC_FCF_FRAME_PENDING)
+		report.flags |= TX_REPORT_ACK_FRAME_PENDING;
+	report.ack_rssi = rx_peek(ACK_LEN_IN_FIFO - 2);
+
+	send_report();
+}
+
+void
+tx_report_poll(void)
+{
+	u16 now = mac_time_ovf();
+
+	__critical {
+		if (waiting_for_ack) {
+			s16 waited = now - MAC_TIME_OVF(report.sfd_time);
+
+			if (waited > ACK_TIMEOUT && (!RADIO.fsmstat1.fifo || waited > ACK_TIMEOUT_MAX))
+				send_report();
+		}
+	}
+}
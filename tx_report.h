@@ -0,0 +1,61 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "bsp/bits.h"
+#include "int.h"
+
+#define TX_REPORT_VERSION 1
+
+// Transmit completion record, sent on status endpoint when enabled
+struct tx_report {
+	u8 version;         // TX_REPORT_VERSION
+	u8 handle;          // wIndex of transmit request, or indirect frame handle
+	u8 status;          // enum ieee802154_status
+	u8 csma_attempts;   // Number of CCAs, 0 if sent without CSMA
+	u8 retries;         // Number of retransmissions (firmware never retransmits)
+	u8 flags;           // enum tx_report_flags
+	s8 ack_rssi;        // RSSI of ACK, if received
+	u8 _reserved;
+	u32 sfd_time;       // MAC time of start of frame delimiter, 0 if not sent
+};
+
+enum tx_report_flags {
+	TX_REPORT_ACK_RECEIVED      = BIT(0),
+	TX_REPORT_ACK_FRAME_PENDING = BIT(1),
+	TX_REPORT_INDIRECT          = BIT(2),
+};
+
+void
+tx_report_enable(__bit enable);
+
+__bit
+tx_report_enabled(void);
+
+void
+tx_report_set_handle(u8 handle);
+
+// Call this when a frame in tx fifo is about to be sent
+void
+tx_report_start(void);
+
+// Outcome of a transmit from tx fifo
+void
+tx_report_done(u8 status, u8 csma_attempts);
+
+// Outcome of a request that never made it to tx fifo
+void
+tx_report_status(u8 status);
+
+// Outcome of an indirect frame that was never sent
+void
+tx_report_indirect(u8 status, u8 handle);
+
+// Look for the ACK to the last frame sent in rx fifo
+void
+tx_report_rx_frame(void);
+
+// Call this periodically from normal context to time out ACK wait
+void
+tx_report_poll(void);
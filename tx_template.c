@@ -0,0 +1,159 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "bsp/radio.h"
+
+#include "config/misc.h"
+#include "int.h"
+#include "log.h"
+#include "tx.h"
+#include "tx_report.h"
+
+#include "tx_template.h"
+
+// Offset of sequence number in MAC header
+#define MHR_DSN_OFFSET 2
+
+// Frames are stored without FCS, just like they're sent with vendor_tx()
+static __xdata struct {
+	u8 len;
+	u8 auto_dsn;
+	u8 dsn;       // Next DSN, if auto_dsn
+	u8 frame[TX_TEMPLATE_MAX_LEN];
+} templates[CONFIG_TX_TEMPLATE_COUNT];
+
+// List of patches: { u8 offset; u8 len; u8 data[len]; } ...
+static __xdata u8 patches[TX_TEMPLATE_PATCH_MAX_LEN];
+
+static u8 pending_id;
+static u8 pending_len;
+
+u8 __xdata *
+tx_template_store_begin(u8 id, u16 len, __bit auto_dsn)
+{
+	LOGDX8(__func__, id);
+
+	if (id >= CONFIG_TX_TEMPLATE_COUNT || !len || len > TX_TEMPLATE_MAX_LEN)
+		return NULL;
+
+	// Template is unusable until the whole frame has been received
+	templates[id].len = 0;
+	templates[id].auto_dsn = auto_dsn && len > MHR_DSN_OFFSET;
+
+	pending_id = id;
+	pending_len = len;
+
+	return templates[id].frame;
+}
+
+void
+tx_template_store_done(void)
+{
+	// Every template has its own sequence, starting at the DSN it was stored
+	// with, as templates are usually for different destinations
+	templates[pending_id].dsn = templates[pending_id].frame[MHR_DSN_OFFSET];
+	templates[pending_id].len = pending_len;
+}
+
+u8 __xdata *
+tx_template_patch_begin(u8 id, u16 len)
+{
+	LOGDX8(__func__, id);
+
+	if (id >= CONFIG_TX_TEMPLATE_COUNT || len > TX_TEMPLATE_PATCH_MAX_LEN)
+		return NULL;
+
+	if (!templates[id].len)
+		return NULL;
+
+	pending_id = id;
+	pending_len = len;
+
+	return patches;
+}
+
+static __bit
+patches_invalid(u8 frame_len)
+{
+	__xdata u8 * p = patches;
+	u8 left = pending_len;
+
+	while (left) {
+		if (left < 2)
+			return 1;
+
+		u8 offset = *p++;
+		u8 n = *p++;
+		left -= 2;
+
+		if (n > left || offset > frame_len || n > frame_len - offset)
+			return 1;
+
+		p += n;
+		left -= n;
+	}
+
+	return 0;
+}
+
+static void
+apply_patches(__xdata u8 * frame)
+{
+	__xdata u8 * p = patches;
+	u8 left = pending_len;
+
+	while (left) {
+		__xdata u8 * dst = frame + *p++;
+		u8 n = *p++;
+		left -= 2 + n;
+
+		while (n--)
+			*dst++ = *p++;
+	}
+}
+
+static __bit
+write_template_to_txfifo(void)
+{
+	__xdata u8 * frame = templates[pending_id].frame;
+	u8 len = templates[pending_id].len;
+
+	// Template may have been replaced while patches were received
+	if (!len || patches_invalid(len)) {
+		tx_report_status(IEEE802154_INVALID_PARAMETER);
+		return 1;
+	}
+
+	if (tx_prepare(len)) {
+		tx_report_status(IEEE802154_TX_ACTIVE);
+		return 1;
+	}
+
+	// Patches are applied in place, and stick for subsequent transmits
+	apply_patches(frame);
+
+	// But a patch can't override an automatically maintained DSN
+	if (templates[pending_id].auto_dsn)
+		frame[MHR_DSN_OFFSET] = templates[pending_id].dsn++;
+
+	do {
+		RFD = *frame++;
+	} while (--len);
+
+	return 0;
+}
+
+void
+tx_template_send_csma(void)
+{
+	if (!write_template_to_txfifo())
+		tx_csma();
+}
+
+void
+tx_template_send_now(void)
+{
+	if (!write_template_to_txfifo())
+		tx_now();
+}
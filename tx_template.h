@@ -0,0 +1,27 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "int.h"
+
+// Largest MPDU we can store, excluding FCS (added by radio)
+#define TX_TEMPLATE_MAX_LEN 125
+
+// Largest list of patches accepted with a template transmit request
+#define TX_TEMPLATE_PATCH_MAX_LEN 32
+
+u8 __xdata *
+tx_template_store_begin(u8 id, u16 len, __bit auto_dsn);
+
+void
+tx_template_store_done(void);
+
+u8 __xdata *
+tx_template_patch_begin(u8 id, u16 len);
+
+void
+tx_template_send_csma(void);
+
+void
+tx_template_send_now(void);
@@ -0,0 +1,34 @@
+// SPDX-FileCopyrightText: 2023 Andreas Sig Rosvall
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "bsp/interrupts.h"
+#include "bsp/usart.h"
+
+#include "int.h"
+
+#include "uart.h"
+
+// Log output waiting for uart. Filled by log_putc in log.S.
+// Indexes wrap around by themselves with a ring of 256 bytes.
+__xdata u8 log_ring[256];
+u8 log_ring_head;
+u8 log_ring_tail;
+
+// Set while uart is sending, so log_putc knows to queue
+__bit log_tx_active;
+
+// Number of bytes dropped because the ring was full
+u16 log_dropped;
+
+INTERRUPT(uart_tx_isr, INTR_UTX1)
+{
+	IRCON2_UTX1IF = 0;
+
+	if (log_ring_head == log_ring_tail) {
+		log_tx_active = 0;
+		return;
+	}
+
+	U1DBUF = log_ring[log_ring_head++];
+}
@@ -5,8 +5,15 @@
 #pragma once
 
 #include "bsp/gpio.h"
+#include "bsp/interrupts.h"
 #include "bsp/usart.h"
 #include "config/pins.h"
+#include "int.h"
+
+// Drains log output. See log.S
+INTERRUPT(uart_tx_isr, INTR_UTX1);
+
+extern u16 log_dropped;
 
 inline void
 uart_setup(void)
@@ -26,6 +33,6 @@ uart_setup(void)
 	// Enable RX interrupt
 	// IEN0_URX0IE = 1;
 
-	// Enable TX interrupt
-	// IEN2 |= IEN2_UTX0IE;
+	// Enable TX interrupt, to drain log ring buffer
+	IEN2 |= IEN2_UTX1IE;
 }
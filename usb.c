@@ -5,12 +5,20 @@
 #include "bsp/gpio.h"
 #include "bsp/interrupts.h"
 #include "bsp/usb.h"
+#include "bsp/watchdog.h"
+#include "boot_timeline.h"
+#include "config/misc.h"
 #include "config/pins.h"
 #include "int.h"
 #include "log.h"
+#include "mac_time.h"
+#include "profile.h"
 #include "radio.h"
 #include "rx.h"
 #include "sleep.h"
+#include "sof_time.h"
+#include "stats.h"
+#include "trace.h"
 #include "tx.h"
 #include "usb.h"
 #include "usb_config.h"
@@ -18,6 +26,18 @@
 
 extern __bit sleep_now;
 
+// Resume signalling must last 1-15 ms. In MAC timer overflows (~1.1 ms)
+#define REMOTE_WAKEUP_SIGNAL_TIME 9
+
+// Bus must have been idle for at least 5 ms before that (USB 2.0, 7.1.7.7).
+// Waiting for more than 5 overflows covers it, whatever the phase.
+#define REMOTE_WAKEUP_IDLE_TIME 5
+
+static __bit suspended;
+static __bit remote_wakeup_enabled;
+static __bit remote_wakeup_pending;
+static u16 suspend_time;
+
 static void
 enable_usb_pll(void)
 {
@@ -42,9 +62,20 @@ inline void
 usb_reset(void)
 {
 	LOGI(__func__);
+	trace(TRACE_USB_RESET, 0);
+	STATS_INC(usb_resets);
 
-	radio_stop();
+	// After fast boot, radio keeps receiving until host has configured us
+	if (!rx_early_active())
+		radio_stop();
 
+	boot_stage(BOOT_USB_RESET);
+
+	suspended = 0;
+	remote_wakeup_enabled = 0;
+	remote_wakeup_pending = 0;
+
+	// Also disables start of frame capture
 	USB.cie = USBCI_RST | USBCI_SUSPEND;
 	USB.pow = USBPOW_SUSPEND_EN;
 
@@ -55,15 +86,90 @@ inline void
 usb_suspend(void)
 {
 	LOGI(__func__);
+	trace(TRACE_USB_SUSPEND, 0);
+	STATS_INC(usb_suspends);
 	disable_usb_pll();
-	sleep_soon();
+	suspended = 1;
+	suspend_time = mac_time_ovf();
+
+	// Stay awake with radio in rx, if host may be woken up by a frame
+	if (!remote_wakeup_enabled)
+		sleep_soon();
 }
 
-inline void
+static void
 usb_resume(void)
 {
 	LOGI(__func__);
+	trace(TRACE_USB_RESUME, 0);
 	enable_usb_pll();
+
+	if (suspended) {
+		suspended = 0;
+		rx_resume();
+	}
+}
+
+void
+usb_set_remote_wakeup(__bit enable)
+{
+	LOGDX8(__func__, enable);
+	remote_wakeup_enabled = enable;
+}
+
+__bit
+usb_remote_wakeup_enabled(void)
+{
+	return remote_wakeup_enabled;
+}
+
+__bit
+usb_remote_wakeup_armed(void)
+{
+	return suspended && remote_wakeup_enabled;
+}
+
+void
+usb_remote_wakeup_request(void)
+{
+	remote_wakeup_pending = 1;
+}
+
+void
+usb_remote_wakeup_poll(void)
+{
+	if (!remote_wakeup_pending)
+		return;
+
+	// Host may have resumed us by itself in the meantime
+	if (!suspended) {
+		remote_wakeup_pending = 0;
+		return;
+	}
+
+	if ((u16)(mac_time_ovf() - suspend_time) <= REMOTE_WAKEUP_IDLE_TIME)
+		return;
+
+	remote_wakeup_pending = 0;
+
+	LOGI(__func__);
+
+	enable_usb_pll();
+
+	trace(TRACE_USB_WAKEUP, 0);
+	USB.pow |= USBPOW_RESUME;
+
+	u16 start = mac_time_ovf();
+	do {
+		watchdog_feed();
+	} while ((u16)(mac_time_ovf() - start) < REMOTE_WAKEUP_SIGNAL_TIME);
+
+	USB.pow &= ~USBPOW_RESUME;
+
+	// Host takes over resume signalling now, so we're as good as resumed
+	__critical {
+		usb_resume();
+	}
 }
 
 inline void
@@ -80,6 +186,11 @@ check_common_flags(void)
 {
 	// Cleared on read
 	u8 flags = USB.cif;
+
+	// First, to keep latency constant
+	if (flags & USBCI_SOF)
+		sof_time_capture();
+
 	if (flags & USBCI_RST)
 		usb_reset();
 
@@ -114,17 +225,22 @@ check_out_ep_flags(void)
 
 INTERRUPT(usb_intr_handler, INTR_P2INT_USB_I2C)
 {
+	PROFILE_ISR_ENTER();
+
 	IRCON2_P2IF = 0;
 	check_common_flags();
 	check_in_ep_flags();
 	check_out_ep_flags();
 	check_wakeup_flag();
+
+	PROFILE_ISR_EXIT(PROFILE_ISR_USB);
 }
 
 void
 usb_init(void)
 {
 	enable_usb_pll();
+	boot_stage(BOOT_USB_PLL);
 
 	gpio_dir_out(USB_DPLUS);
 	gpio_set_high(USB_DPLUS);
@@ -9,3 +9,21 @@ INTERRUPT(usb_intr_handler, INTR_P2INT_USB_I2C);
 
 void
 usb_init(void);
+
+void
+usb_set_remote_wakeup(__bit enable);
+
+__bit
+usb_remote_wakeup_enabled(void);
+
+// Set if a received frame should wake up host
+__bit
+usb_remote_wakeup_armed(void);
+
+// Call this from interrupt context to wake up host
+void
+usb_remote_wakeup_request(void);
+
+// Call this periodically from normal context to signal remote wakeup if requested
+void
+usb_remote_wakeup_poll(void);
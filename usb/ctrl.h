@@ -77,12 +77,34 @@ enum usb_req_standard {
 };
 
 enum usb_vendor_req {
-	USB_REQ_VENDOR_XDATA_READ  =  0u,
-	USB_REQ_VENDOR_XDATA_WRITE =  1u,
-	USB_REQ_VENDOR_FIFO_READ   =  2u,
-	USB_REQ_VENDOR_FIFO_WRITE  =  3u,
-	USB_REQ_VENDOR_TX          =  4u,
-	USB_REQ_VENDOR_SET_CSMA    =  5u,
+	USB_REQ_VENDOR_XDATA_READ         =  0u,
+	USB_REQ_VENDOR_XDATA_WRITE        =  1u,
+	USB_REQ_VENDOR_FIFO_READ          =  2u,
+	USB_REQ_VENDOR_FIFO_WRITE         =  3u,
+	USB_REQ_VENDOR_TX                 =  4u,
+	USB_REQ_VENDOR_SET_CSMA           =  5u,
+	USB_REQ_VENDOR_TX_TEMPLATE_SET    =  6u,
+	USB_REQ_VENDOR_TX_TEMPLATE        =  7u,
+	USB_REQ_VENDOR_INDIRECT_QUEUE     =  8u,
+	USB_REQ_VENDOR_INDIRECT_PURGE     =  9u,
+	USB_REQ_VENDOR_SET_POLL_RESPONDER = 10u,
+	USB_REQ_VENDOR_GET_POLL_COUNT     = 11u,
+	USB_REQ_VENDOR_TX_PARAMS          = 12u,
+	USB_REQ_VENDOR_SET_TX_REPORT      = 13u,
+	USB_REQ_VENDOR_SET_NOTIFY         = 14u,
+	USB_REQ_VENDOR_SET_WAKE_FILTER    = 15u,
+	USB_REQ_VENDOR_GET_SOF_TIME       = 16u,
+	USB_REQ_VENDOR_SET_SOF_TIME       = 17u,
+	USB_REQ_VENDOR_GET_PROFILE        = 18u,
+	USB_REQ_VENDOR_GET_TRACE          = 19u,
+	USB_REQ_VENDOR_GET_LATENCY        = 20u,
+	USB_REQ_VENDOR_GET_STATS          = 21u,
+	USB_REQ_VENDOR_GET_MEM_USAGE      = 22u,
+	USB_REQ_VENDOR_GET_CAPS           = 23u,
+	USB_REQ_VENDOR_SET_FEATURES       = 24u,
+	USB_REQ_VENDOR_CONFIG_WRITE       = 25u,
+	USB_REQ_VENDOR_CONFIG_READ        = 26u,
+	USB_REQ_VENDOR_GET_BOOT_TIMELINE  = 27u,
 };
 
 enum usb_req_dfu {
@@ -12,7 +12,7 @@
 
 #define CTRL_EP_MAXPKTSIZE  USB_EP0_FIFO_SIZE
 #define RXPKT_EP_MAXPKTSIZE USB_FULLSPEED_MAXPKTSIZE
-#define INT_EP_MAXPKTSIZE   8
+#define INT_EP_MAXPKTSIZE   16
 
 enum {
 	USB_INTERFACE_NUM_WPAN = 0,
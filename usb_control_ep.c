@@ -8,12 +8,28 @@
 #include "bsp/usb.h"
 
 #include "usb/descriptor.h"
-
+#include "config/misc.h"
+#include "boot_timeline.h"
+#include "caps.h"
+
+#include "flash_config.h"
+#include "indirect.h"
+#include "latency.h"
+#include "mem_usage.h"
 #include "int.h"
 #include "log.h"
+#include "notify.h"
+#include "poll_responder.h"
+#include "profile.h"
 #include "rx.h"
+#include "sof_time.h"
+#include "stats.h"
+#include "trace.h"
 #include "tx.h"
+#include "tx_template.h"
+#include "tx_report.h"
 #include "bootloader.h"
+#include "usb.h"
 #include "usb_config.h"
 #include "dyn_usb_desc.h"
 #include "const_usb_desc.h"
@@ -25,7 +41,10 @@
 
 static struct dma_conf dma;
 static void (* request_done)(void);
+static void (* request_aborted)(void);
 static struct usb_setup request;
+// Set if we have less data than host asked for
+static __bit short_reply;
 static enum {
 	STATE_IDLE,
 	STATE_RX,
@@ -52,6 +71,11 @@ copy_chunk_with_dma(void)
 
 		dma_trig(DMA_CH);
 	} while (--n);
+
+	// A whole packet ends the data stage too, if that was all of it.
+	// Unless host asked for more, and waits for a short packet.
+	if (!dma_is_armed(DMA_CH) && !short_reply)
+		SET_STATE(STATE_DONE);
 }
 
 static void
@@ -59,6 +83,12 @@ setup_tx_dma(const void __xdata * src, __bit not_fifo)
 {
 	LOGDX16(__func__, (u16)src);
 
+	// No data stage, so nothing to arm the DMA for
+	if (!request.wLength) {
+		SET_STATE(STATE_DONE);
+		return;
+	}
+
 	dma_set_src(dma, src);
 	dma_set_dst(dma, &USB.fifo[CTRL_EP].fifo);
 	dma_set_len(dma, request.wLength);
@@ -75,6 +105,11 @@ setup_rx_dma(void __xdata * dst, __bit not_fifo)
 {
 	LOGDX16(__func__, (u16)dst);
 
+	if (!request.wLength) {
+		SET_STATE(STATE_DONE);
+		return;
+	}
+
 	dma_set_src(dma, &USB.fifo[CTRL_EP].fifo);
 	dma_set_dst(dma, dst);
 	dma_set_len(dma, request.wLength);
@@ -228,8 +263,45 @@ get_dev_status(void)
 	// bit 1: remote wakeup
 	// rest: 0/reserved
 
-	// We're never self powered, and don't support remote wakeup.
-	send_zeroes(2);
+	// We're never self powered
+	if (request.wLength != 2) {
+		SET_STATE(STATE_STALL);
+		return;
+	}
+
+	static __xdata u16 status;
+
+	status = usb_remote_wakeup_enabled() << 1;
+
+	setup_tx_dma(&status, NOT_FIFO);
+}
+
+static void
+set_dev_feature(void)
+{
+	LOGDX8(__func__, request.wValue);
+
+	if (!CONFIG_USB_REMOTE_WAKEUP || request.wLength != 0 || request.wValue != USB_FEATURE_DEVICE_REMOTE_WAKEUP) {
+		SET_STATE(STATE_STALL);
+		return;
+	}
+
+	usb_set_remote_wakeup(1);
+	SET_STATE(STATE_DONE);
+}
+
+static void
+clear_dev_feature(void)
+{
+	LOGDX8(__func__, request.wValue);
+
+	if (!CONFIG_USB_REMOTE_WAKEUP || request.wLength != 0 || request.wValue != USB_FEATURE_DEVICE_REMOTE_WAKEUP) {
+		SET_STATE(STATE_STALL);
+		return;
+	}
+
+	usb_set_remote_wakeup(0);
+	SET_STATE(STATE_DONE);
 }
 
 static void
@@ -252,6 +324,7 @@ set_configuration(void)
 	current_configuration = conf;
 
 	if (conf) {
+		boot_stage(BOOT_USB_CONFIGURED);
 		rx_setup();
 		tx_setup();
 		usb_select_endpoint(CTRL_EP);
@@ -281,6 +354,7 @@ set_address(void)
 	LOGDX8(__func__, addr);
 
 	USB.addr = addr;
+	boot_stage(BOOT_USB_ADDRESS);
 
 	current_configuration = 0;
 	SET_STATE(STATE_DONE);
@@ -304,8 +378,10 @@ get_descriptor(void)
 	}
 
 	u8 len = usb_desc_total_len(desc);
-	if (len < request.wLength)
+	if (len < request.wLength) {
 		request.wLength = len;
+		short_reply = 1;
+	}
 
 	setup_tx_dma(desc, NOT_FIFO);
 }
@@ -380,12 +456,22 @@ vendor_fifo_read(void)
 static void
 vendor_tx(void)
 {
+	latency_tx_request();
+	tx_report_set_handle(request.wIndex);
+
+	// Anything longer would overflow the tx fifo, and wedge the radio
+	if (!request.wLength || request.wLength > TX_MAX_LEN) {
+		SET_STATE(STATE_STALL);
+		return;
+	}
+
 	__bit err = tx_prepare(request.wLength);
 	if (err) {
 		SET_STATE(STATE_STALL);
 	} else {
 		// Write usb control packet data directly to TXFIFO
 		setup_rx_dma(&X_RFD, IS_FIFO);
+		request_aborted = tx_abort;
 		if (request.wValue)
 			request_done = tx_now;
 		else
@@ -393,6 +479,262 @@ vendor_tx(void)
 	}
 }
 
+static void
+vendor_tx_params(void)
+{
+	latency_tx_request();
+	tx_report_set_handle(request.wIndex);
+
+	u8 __xdata * dst = tx_params_begin(request.wLength);
+	if (!dst) {
+		SET_STATE(STATE_STALL);
+		return;
+	}
+
+	setup_rx_dma(dst, NOT_FIFO);
+	if (request.wValue)
+		request_done = tx_params_send_now;
+	else
+		request_done = tx_params_send_csma;
+}
+
+static void
+vendor_tx_template_set(void)
+{
+	LOGDX16(__func__, request.wValue);
+
+	u8 __xdata * dst = tx_template_store_begin(request.wValue, request.wLength, request.wIndex != 0);
+	if (!dst) {
+		SET_STATE(STATE_STALL);
+	} else {
+		setup_rx_dma(dst, NOT_FIFO);
+		request_done = tx_template_store_done;
+	}
+}
+
+static void
+vendor_tx_template(void)
+{
+	latency_tx_request();
+	tx_report_set_handle(request.wIndex);
+
+	u8 __xdata * patches = tx_template_patch_begin(request.wValue, request.wLength);
+	if (!patches) {
+		SET_STATE(STATE_STALL);
+		return;
+	}
+
+	// Usually nothing but the DSN changes, so there's no data stage
+	if (request.wLength)
+		setup_rx_dma(patches, NOT_FIFO);
+	else
+		SET_STATE(STATE_DONE);
+
+	if (request.wValue >> 8)
+		request_done = tx_template_send_now;
+	else
+		request_done = tx_template_send_csma;
+}
+
+static void
+vendor_indirect_queue(void)
+{
+	LOGDX8(__func__, request.wValue);
+
+	u8 __xdata * dst = indirect_enqueue_begin(request.wValue, request.wIndex, request.wLength);
+	if (!dst) {
+		SET_STATE(STATE_STALL);
+	} else {
+		setup_rx_dma(dst, NOT_FIFO);
+		request_done = indirect_enqueue_done;
+	}
+}
+
+static void
+vendor_indirect_purge(void)
+{
+	if (indirect_purge(request.wValue)) {
+		SET_STATE(STATE_DONE);
+	} else {
+		SET_STATE(STATE_STALL);
+	}
+}
+
+static void
+vendor_set_poll_responder(void)
+{
+	poll_responder_enable(request.wValue != 0);
+	SET_STATE(STATE_DONE);
+}
+
+static void
+vendor_get_poll_count(void)
+{
+	if (request.wLength != 2) {
+		SET_STATE(STATE_STALL);
+		return;
+	}
+
+	setup_tx_dma(poll_responder_count(), NOT_FIFO);
+}
+
+static void
+vendor_set_tx_report(void)
+{
+	tx_report_enable(request.wValue != 0);
+	SET_STATE(STATE_DONE);
+}
+
+static void
+vendor_set_notify(void)
+{
+	notify_set_packed(request.wValue != 0);
+	SET_STATE(STATE_DONE);
+}
+
+static void
+vendor_set_wake_filter(void)
+{
+	rx_set_wake_filter(request.wValue);
+	SET_STATE(STATE_DONE);
+}
+
+static void
+vendor_set_sof_time(void)
+{
+	sof_time_enable(request.wValue != 0);
+	SET_STATE(STATE_DONE);
+}
+
+static void
+vendor_get_sof_time(void)
+{
+	if (request.wLength > sizeof(struct sof_time_snapshot)) {
+		SET_STATE(STATE_STALL);
+		return;
+	}
+
+	setup_tx_dma(sof_time_snapshot(), NOT_FIFO);
+}
+
+static void
+vendor_get_profile(void)
+{
+#ifdef PROFILE_ISR
+	if (request.wLength > sizeof(struct profile)) {
+		SET_STATE(STATE_STALL);
+		return;
+	}
+
+	setup_tx_dma(profile_snapshot(request.wValue != 0), NOT_FIFO);
+#else
+	// Not built with PROFILE_ISR=1
+	SET_STATE(STATE_STALL);
+#endif
+}
+
+static void
+vendor_get_trace(void)
+{
+	if (request.wLength > sizeof(struct trace)) {
+		SET_STATE(STATE_STALL);
+		return;
+	}
+
+	// Straight from the live buffer, so tracing never stops
+	setup_tx_dma(trace_buffer(), NOT_FIFO);
+}
+
+static void
+vendor_get_latency(void)
+{
+	if (request.wLength > sizeof(struct latency)) {
+		SET_STATE(STATE_STALL);
+		return;
+	}
+
+	setup_tx_dma(latency_snapshot(request.wValue != 0), NOT_FIFO);
+}
+
+static void
+vendor_get_stats(void)
+{
+	if (request.wLength > sizeof(struct stats)) {
+		SET_STATE(STATE_STALL);
+		return;
+	}
+
+	setup_tx_dma(stats_snapshot(), NOT_FIFO);
+}
+
+static void
+vendor_get_mem_usage(void)
+{
+	if (request.wLength > sizeof(struct mem_usage)) {
+		SET_STATE(STATE_STALL);
+		return;
+	}
+
+	setup_tx_dma(mem_usage(), NOT_FIFO);
+}
+
+static void
+vendor_get_caps(void)
+{
+	if (request.wLength > sizeof(struct caps)) {
+		SET_STATE(STATE_STALL);
+		return;
+	}
+
+	setup_tx_dma(caps_get(), NOT_FIFO);
+}
+
+static void
+vendor_config_write(void)
+{
+	u8 __xdata * dst = flash_config_write_begin(request.wLength);
+	if (!dst) {
+		SET_STATE(STATE_STALL);
+		return;
+	}
+
+	setup_rx_dma(dst, NOT_FIFO);
+	request_done = flash_config_write_done;
+}
+
+static void
+vendor_config_read(void)
+{
+	if (request.wLength > FLASH_CONFIG_MAX_LEN) {
+		SET_STATE(STATE_STALL);
+		return;
+	}
+
+	setup_tx_dma(flash_config_read(), NOT_FIFO);
+}
+
+static void
+vendor_get_boot_timeline(void)
+{
+	if (request.wLength > sizeof(struct boot_timeline)) {
+		SET_STATE(STATE_STALL);
+		return;
+	}
+
+	setup_tx_dma(boot_timeline(), NOT_FIFO);
+}
+
+static void
+vendor_set_features(void)
+{
+	if (caps_set_features(request.wValue)) {
+		SET_STATE(STATE_STALL);
+		return;
+	}
+
+	SET_STATE(STATE_DONE);
+}
+
 static void
 vendor_set_csma(void)
 {
@@ -433,14 +775,38 @@ handle_request(void)
 		REQ(VENDOR_FIFO_WRITE,  vendor_fifo_write)
 		REQ(VENDOR_TX,          vendor_tx) 
 		REQ(VENDOR_SET_CSMA,    vendor_set_csma)
+		REQ(VENDOR_TX_TEMPLATE_SET, vendor_tx_template_set)
+		REQ(VENDOR_TX_TEMPLATE, vendor_tx_template)
+		REQ(VENDOR_INDIRECT_QUEUE, vendor_indirect_queue)
+		REQ(VENDOR_INDIRECT_PURGE, vendor_indirect_purge)
+		REQ(VENDOR_SET_POLL_RESPONDER, vendor_set_poll_responder)
+		REQ(VENDOR_TX_PARAMS,   vendor_tx_params)
+		REQ(VENDOR_SET_TX_REPORT, vendor_set_tx_report)
+		REQ(VENDOR_SET_NOTIFY,  vendor_set_notify)
+		REQ(VENDOR_SET_WAKE_FILTER, vendor_set_wake_filter)
+		REQ(VENDOR_SET_SOF_TIME, vendor_set_sof_time)
+		REQ(VENDOR_SET_FEATURES, vendor_set_features)
+		REQ(VENDOR_CONFIG_WRITE, vendor_config_write)
 	)
 	RT(VENDOR_DEV_IN, 
 		REQ(VENDOR_XDATA_READ,  vendor_xdata_read)
 		REQ(VENDOR_FIFO_READ,   vendor_fifo_read)
+		REQ(VENDOR_GET_POLL_COUNT, vendor_get_poll_count)
+		REQ(VENDOR_GET_SOF_TIME, vendor_get_sof_time)
+		REQ(VENDOR_GET_PROFILE, vendor_get_profile)
+		REQ(VENDOR_GET_TRACE,   vendor_get_trace)
+		REQ(VENDOR_GET_LATENCY, vendor_get_latency)
+		REQ(VENDOR_GET_STATS,   vendor_get_stats)
+		REQ(VENDOR_GET_MEM_USAGE, vendor_get_mem_usage)
+		REQ(VENDOR_GET_CAPS,    vendor_get_caps)
+		REQ(VENDOR_CONFIG_READ, vendor_config_read)
+		REQ(VENDOR_GET_BOOT_TIMELINE, vendor_get_boot_timeline)
 	)
 	RT(STD_DEV_OUT, 
 		REQ(SET_ADDRESS,        set_address) 
 		REQ(SET_CONFIGURATION,  set_configuration)
+		REQ(SET_FEATURE,        set_dev_feature)
+		REQ(CLEAR_FEATURE,      clear_dev_feature)
 	)
 	RT(STD_DEV_IN, 
 		REQ(GET_STATUS,         get_dev_status) 
@@ -483,6 +849,18 @@ do_nothing(void)
 {
 }
 
+// Host gave up on a request in its data stage
+static void
+abort_request(void)
+{
+	if (state != STATE_RX && state != STATE_TX)
+		return;
+
+	// DMAARM.ABORT
+	DMAARM = BIT(7) | BIT(DMA_CH);
+	request_aborted();
+}
+
 void
 usb_control_intr_handler(void)
 {
@@ -492,6 +870,7 @@ usb_control_intr_handler(void)
 
 	if (flags & USBCS0_SETUP_END) {
 		USB.ctrl_ep.cs0 = USBCS0_CLR_SETUP_END;
+		abort_request();
 		SET_STATE(STATE_IDLE);
 		LOGW("EP0: setup end");
 	}
@@ -499,6 +878,7 @@ usb_control_intr_handler(void)
 	if (flags & USBCS0_SENT_STALL) {
 		USB.ctrl_ep.cs0 = 0;
 		SET_STATE(STATE_IDLE);
+		STATS_INC(usb_stalls);
 		LOGW("EP0: sent stall");
 		LOGWX16("request", *(u16 *)&request);
 		LOGWX16("wValue ", request.wValue);
@@ -508,14 +888,15 @@ usb_control_intr_handler(void)
 
 	if (flags & USBCS0_OUTPKT_RDY) {
 		if (state == STATE_IDLE) {
+			PROFILE_REQ_ENTER();
 			request_done = do_nothing;
+			request_aborted = do_nothing;
+			short_reply = 0;
 			recv_request();
 			handle_request();
+			PROFILE_REQ_EXIT(&request);
 		} else if (state == STATE_RX) {
 			copy_chunk_with_dma();
-
-			if (!dma_is_armed(DMA_CH))
-				SET_STATE(STATE_DONE);
 		}
 
 		u8 reg = USBCS0_CLR_OUTPKT_RDY;
@@ -535,8 +916,10 @@ usb_control_intr_handler(void)
 	}
 
 	if (state == STATE_DONE) {
+		PROFILE_REQ_ENTER();
 		SET_STATE(STATE_IDLE);
 		request_done();
+		PROFILE_REQ_EXIT(&request);
 	}
 }
 
@@ -544,6 +927,7 @@ void
 usb_control_reset(void)
 {
 	current_configuration = 0;
+	abort_request();
 	SET_STATE(STATE_IDLE);
 }
 